@@ -1,8 +1,24 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <algorithm>
 #include <unordered_map>
 #include <cstdint>
+#include <string_view>
+#include <array>
+#include <span>
+#include <tuple>
+#include <atomic>
+#include <utility>
+#include <type_traits>
+#include <cstring>
+#include <cassert>
+#include <memory>
+#include <limits>
+#include <cmath>
+
+#include "ecsmath.h"
 
 template< typename T >
 struct TypeName;
@@ -30,11 +46,9 @@ public:
 	{
 	}
 
-	EntityId(const EntityId& c)
-		: mIndex(c.mIndex)
-		, mCount(c.mCount)
-	{
-	}
+	// defaulted so entity columns stay trivially copyable for snapshots
+	EntityId(const EntityId& c) = default;
+	EntityId& operator=(const EntityId& c) = default;
 
 	EntityId(uint64_t i)
 	{
@@ -57,17 +71,66 @@ public:
 };
 
 
-class ECS_Math {
+class EntityCommands;
+
+// Scratch memory for the jobs of one frame: a bump allocator per worker slot, so allocating is a
+// pointer increment with no contention, and Reset frees everything at once when the frame is
+// retired. Blocks are kept across frames, so a steady workload stops allocating from the heap.
+class FrameScratch
+{
 public:
-	float lookAt(float ax, float ay, float bx, float by) const {
-		//placeholder
-		return 0.0f;
-	};
+	static constexpr size_t kBlockSize = 64 * 1024;
+
+	FrameScratch(uint32_t numWorkerSlots)
+	: mArenas(numWorkerSlots)
+	{
+	}
+
+	void* Allocate(uint32_t workerSlot, size_t size, size_t align) {
+		Arena& arena = mArenas[workerSlot];
+		while (true) {
+			while (arena.mBlock < arena.mBlocks.size()) {
+				Block& block = arena.mBlocks[arena.mBlock];
+				const uintptr_t base = uintptr_t(block.mData.get());
+				const size_t offset = size_t(((base + arena.mOffset + align - 1) & ~uintptr_t(align - 1)) - base);
+				if (offset + size <= block.mSize) {
+					arena.mOffset = offset + size;
+					return block.mData.get() + offset;
+				}
+				++arena.mBlock;
+				arena.mOffset = 0;
+			}
+
+			// every kept block is used up, add one, large enough for an oversized request
+			const size_t blockSize = std::max(kBlockSize, size + align);
+			arena.mBlocks.push_back(Block{ std::make_unique<char[]>(blockSize), blockSize });
+		}
+	}
 
-	float forward(float r) const {
-		//placeholder
-		return 0.0f;
+	// Frees every allocation of every worker, only once no job of the frame is running
+	void Reset() {
+		for (Arena& arena : mArenas) {
+			arena.mBlock = 0;
+			arena.mOffset = 0;
+		}
 	}
+
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]>		mData;
+		size_t						mSize;
+	};
+
+	// aligned so workers allocating side by side don't share cache lines
+	struct alignas(64) Arena
+	{
+		std::vector<Block>		mBlocks;
+		size_t					mBlock = 0;			// block being allocated from
+		size_t					mOffset = 0;		// within mBlock
+	};
+
+	std::vector<Arena>		mArenas;			// one per worker slot
 };
 
 class ECS_Context {
@@ -76,48 +139,209 @@ public:
 	: thisEntityId(EntityId())
 	, deltaTime(1.0f / 30.0f)
 	, isGameOver(false)
-	, taskManager(nullptr)
+	, frameIndex(0)
+	, workerSlot(0)
+	, taskOrder(0)
+	, commands(nullptr)
+	, scratch(nullptr)
 	{
 	}
 
+	// Uninitialized scratch memory that stays valid until the frame is retired, never freed
+	// individually. Only for trivially destructible types, destructors never run.
+	void*		AllocScratch(size_t size, size_t align) const {
+		assert(scratch != nullptr);
+		return scratch->Allocate(workerSlot, size, align);
+	}
+
+	template< class T >
+	std::span<T>	AllocScratchArray(size_t count) const {
+		static_assert(std::is_trivially_destructible_v<T>, "scratch memory is released without running destructors");
+		T* data = static_cast<T*>(AllocScratch(count * sizeof(T), alignof(T)));
+		std::uninitialized_value_construct_n(data, count);
+		return std::span<T>(data, count);
+	}
+
+	// Structural changes from inside a job, applied when the update step's commands are played
+	// back. A created entity's id can be used in later commands of the same job.
+	EntityId	DeferCreateEntity() const;
+	void		DeferDestroyEntity(EntityId id) const;
+	template< class T >
+	void		DeferAddComponent(EntityId id) const;
+	template< class T >
+	void		DeferAddComponent(EntityId id, const T& value) const;
+	template< class T >
+	void		DeferRemoveComponent(EntityId id) const;
+
 	EntityId	thisEntityId;
 	float		deltaTime;
 	bool		isGameOver;
+	uint32_t	frameIndex;			// frame this context's jobs belong to, stamps component changes
+	uint32_t	workerSlot;			// worker running the job, selects its command buffer
+	uint32_t	taskOrder;			// position of the job's task in program order, orders its commands
+	EntityCommands*	commands;		// null when the frame plays back no commands
+	FrameScratch*	scratch;		// the frame's scratch memory, see AllocScratch
 	ECS_Math	math;				// guaranteed pure / thread-safe math library
-	void*		taskManager;		// guaranteed thread-safe task manager TODO:
 };
 
 
+typedef uint64_t ComponentTypeId;
+
+// FNV-1a of the component name, usable in constant expressions
+constexpr ComponentTypeId GetComponentTypeId(std::string_view name) {
+	ComponentTypeId hash = 14695981039346656037ull;
+	for (char c : name) {
+		hash ^= ComponentTypeId(uint8_t(c));
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Generated by @component as static constexpr tables, see ComponentFunctionTable. Every
+// name is a view of a string literal and dependencies and fields are ranges into the
+// component's flat tables, so reading them never allocates.
 struct ComponentTask
 {
 	struct Dependency
 	{
 		enum class Direction { unknown, in, out, inout };
-		enum class Type { Unknown, This, Ctx, MyComponent, AllComponents };
-	
-		Dependency(Direction dir, Type type, const std::string& component, const std::string& name)
+		enum class Type { Unknown, This, Ctx, MyComponent, AllComponents, SpatialIndex, EventStream };
+
+		// A member field of the component the function body actually touches
+		struct Field
+		{
+			constexpr Field(Direction dir, std::string_view name)
+			: mDir(dir)
+			, mName(name)
+			{
+			}
+
+			Direction			mDir;
+			std::string_view	mName;
+		};
+
+		constexpr Dependency(Direction dir, Type type, std::string_view component, std::string_view name, uint16_t firstField, uint16_t numFields)
 		: mDir(dir)
 		, mType(type)
+		, mComponentId(GetComponentTypeId(component))
 		, mComponentName(component)
 		, mName(name)
+		, mFirstField(firstField)
+		, mNumFields(numFields)
 		{
 		}
 
-		Direction		mDir;
-		Type			mType;
-		std::string		mComponentName;
-		std::string		mName;
+		Direction			mDir;
+		Type				mType;
+		ComponentTypeId		mComponentId;
+		std::string_view	mComponentName;
+		std::string_view	mName;
+		uint16_t			mFirstField;
+		uint16_t			mNumFields;		// zero when the whole component is accessed
 	};
 
-	ComponentTask(const std::string& name, std::vector<Dependency> i)
+	constexpr ComponentTask(std::string_view name, uint16_t firstDependency, uint16_t numDependencies)
 	: mName(name)
+	, mFirstDependency(firstDependency)
+	, mNumDependencies(numDependencies)
 	{
 	}
 
-	std::string						mName;
-	std::vector<Dependency>			mDepends;
+	std::string_view	mName;
+	uint16_t			mFirstDependency;
+	uint16_t			mNumDependencies;
+};
+
+// Builds a generated static table, so the metafunction does not need to count its entries
+template< class T, class... Args >
+constexpr std::array<T, sizeof...(Args)> MakeComponentTable(Args... args) {
+	return { T(args)... };
+}
+
+// View over the static tables @component generates for a type
+struct ComponentFunctionTable
+{
+	std::span<const ComponentTask>							mTasks;
+	std::span<const ComponentTask::Dependency>				mDependencies;
+	std::span<const ComponentTask::Dependency::Field>		mFields;
+	std::span<const std::string_view>						mMembers;
+
+	constexpr std::span<const ComponentTask::Dependency> GetDependencies(const ComponentTask& task) const {
+		return mDependencies.subspan(task.mFirstDependency, task.mNumDependencies);
+	}
+
+	constexpr std::span<const ComponentTask::Dependency::Field> GetFields(const ComponentTask::Dependency& dn) const {
+		return mFields.subspan(dn.mFirstField, dn.mNumFields);
+	}
+
+	constexpr bool HasMember(std::string_view name) const {
+		for (std::string_view member : mMembers) {
+			if (member == name) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+template< class T >
+constexpr ComponentFunctionTable GetComponentFunctionTable() {
+	return { T::ComponentTasks, T::ComponentDependencies, T::ComponentFields, T::ComponentMembers };
+}
+
+// True for types declared @component, which the metafunction gives the tables above. Checked
+// by the generated shims for every component parameter.
+template< class T >
+constexpr bool IsComponentType = requires {
+	T::ComponentTasks;
+	T::ComponentDependencies;
+	T::ComponentFields;
+	T::ComponentMembers;
 };
 
+// Identifies the layout of a component from its generated member list and size, so a snapshot
+// is never loaded into a component whose members changed since it was saved
+template< class T >
+constexpr uint64_t GetComponentSchemaHash() {
+	uint64_t hash = GetComponentTypeId("");
+	for (std::string_view member : T::ComponentMembers) {
+		hash = (hash ^ GetComponentTypeId(member)) * 1099511628211ull;
+	}
+	return (hash ^ sizeof(T)) * 1099511628211ull;
+}
+
+// Checked when a component is registered: every task is a known update step and appears once,
+// every range is inside its table, and every field of the component's own type exists.
+constexpr bool IsValidComponentFunctionTable(const ComponentFunctionTable& table) {
+	for (size_t iTask = 0; iTask < table.mTasks.size(); ++iTask) {
+		const ComponentTask& task = table.mTasks[iTask];
+		if (task.mName != "PreUpdate" && task.mName != "Update" && task.mName != "PostUpdate") {
+			return false;
+		}
+		for (size_t iOther = 0; iOther < iTask; ++iOther) {
+			if (table.mTasks[iOther].mName == task.mName) {
+				return false;
+			}
+		}
+		if (size_t(task.mFirstDependency) + task.mNumDependencies > table.mDependencies.size()) {
+			return false;
+		}
+		for (const ComponentTask::Dependency& dn : table.GetDependencies(task)) {
+			if (size_t(dn.mFirstField) + dn.mNumFields > table.mFields.size()) {
+				return false;
+			}
+			if (dn.mType == ComponentTask::Dependency::Type::This) {
+				for (const ComponentTask::Dependency::Field& field : table.GetFields(dn)) {
+					if (!table.HasMember(field.mName)) {
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
 //class Component {
 //private: std::string m_id;
 //public: Component() = default;
@@ -126,29 +350,248 @@ struct ComponentTask
 //
 //};
 class ComponentManager;
+class IComponentSystem;
+
+// Told by the component systems it spans about every structural change, see ComponentQuery
+class IComponentQuery
+{
+public:
+	virtual void OnAlloc(EntityId id) = 0;
+
+	virtual void OnFree(EntityId id) = 0;
+
+	virtual void OnRowMoved(IComponentSystem* sys, EntityId id, uint32_t row) = 0;
+
+	// Every row of a system was replaced at once, e.g. by loading a snapshot
+	virtual void OnReset() = 0;
+};
+
+// One row of a component system: the component and the entity that owns it
+template< class T >
+struct ComponentRow
+{
+	T&			mComponent;
+	EntityId	mEntity;
+};
+
+template< class T >
+class ComponentSystem;
+
+// Raises a change version that jobs of several frames in flight may stamp at once, so the
+// newest frame wins. Most calls find the stamp already current and don't write at all.
+inline void RaiseChangeVersion(uint32_t& version, uint32_t frameIndex) {
+	std::atomic_ref<uint32_t> stamp(version);
+	uint32_t current = stamp.load(std::memory_order_relaxed);
+	while (current < frameIndex && !stamp.compare_exchange_weak(current, frameIndex, std::memory_order_relaxed)) {
+	}
+}
+
+// Contiguous rows [begin, end) of a component system. The Run<Step> shims, generated or declared
+// by the component, iterate one of these with the dependent systems already resolved.
+template< class T >
+class ComponentRange
+{
+public:
+	class Iterator
+	{
+	public:
+		Iterator(T* data, const EntityId* entities, uint32_t row)
+		: mData(data)
+		, mEntities(entities)
+		, mRow(row)
+		{
+		}
+
+		ComponentRow<T> operator*() const {
+			return ComponentRow<T>{ mData[mRow], mEntities[mRow] };
+		}
+
+		Iterator& operator++() {
+			++mRow;
+			return *this;
+		}
+
+		bool operator!=(const Iterator& other) const {
+			return mRow != other.mRow;
+		}
+
+	private:
+		T*					mData;
+		const EntityId*		mEntities;
+		uint32_t			mRow;
+	};
+
+	ComponentRange(ComponentSystem<T>* system, T* data, const EntityId* entities, uint32_t begin, uint32_t end)
+	: mSystem(system)
+	, mData(data)
+	, mEntities(entities)
+	, mBegin(begin)
+	, mEnd(end)
+	{
+	}
+
+	Iterator begin() const {
+		return Iterator(mData, mEntities, mBegin);
+	}
+
+	Iterator end() const {
+		return Iterator(mData, mEntities, mEnd);
+	}
+
+	uint32_t Size() const {
+		return mEnd - mBegin;
+	}
+
+	uint32_t GetBegin() const {
+		return mBegin;
+	}
+
+	uint32_t GetEnd() const {
+		return mEnd;
+	}
+
+	ComponentSystem<T>* GetSystem() const {
+		return mSystem;
+	}
+
+	ComponentRow<T> GetRow(uint32_t row) const {
+		return ComponentRow<T>{ mData[row], mEntities[row] };
+	}
+
+	// Rows [begin, end) of this range
+	ComponentRange<T> Slice(uint32_t begin, uint32_t end) const {
+		assert(mBegin <= begin && begin <= end && end <= mEnd);
+		return ComponentRange<T>(mSystem, mData, mEntities, begin, end);
+	}
+
+	// End of the chunk holding row, within this range, for a hand-written Run<Step> that
+	// gathers its rows a chunk at a time
+	uint32_t GetChunkEnd(uint32_t row) const {
+		constexpr uint32_t kChunkRows = ComponentSystem<T>::kChunkRows;
+		return std::min(row - row % kChunkRows + kChunkRows, mEnd);
+	}
+
+	// Stamps every chunk of the range as written in frameIndex, for shims with `inout this`
+	void MarkChanged(uint32_t frameIndex) const {
+		mSystem->MarkRowsChanged(mBegin, mEnd, frameIndex);
+	}
+
+	// Calls f(subRange) for each run of whole chunks within this range that changed after
+	// frame sinceFrame, skipping untouched chunks without looking at their rows
+	template< class F >
+	void ForEachChangedSince(uint32_t sinceFrame, const F& f) const {
+		constexpr uint32_t kChunkRows = ComponentSystem<T>::kChunkRows;
+		uint32_t runBegin = mBegin;
+		bool inRun = false;
+		for (uint32_t chunkBegin = mBegin - mBegin % kChunkRows; chunkBegin < mEnd; chunkBegin += kChunkRows) {
+			const bool changed = mSystem->IsChunkChangedSince(chunkBegin / kChunkRows, sinceFrame);
+			if (changed && !inRun) {
+				runBegin = std::max(chunkBegin, mBegin);
+				inRun = true;
+			}
+			else if (!changed && inRun) {
+				f(ComponentRange<T>(mSystem, mData, mEntities, runBegin, chunkBegin));
+				inRun = false;
+			}
+		}
+		if (inRun) {
+			f(ComponentRange<T>(mSystem, mData, mEntities, runBegin, mEnd));
+		}
+	}
+
+private:
+	ComponentSystem<T>*	mSystem;
+	T*					mData;
+	const EntityId*		mEntities;
+	uint32_t			mBegin;
+	uint32_t			mEnd;
+};
 
 class IComponentSystem
 {
 public:
+	static constexpr uint32_t kChunkRows = 64;		// rows sharing a change version
+
 	virtual const std::string Name() = 0;
 
 	virtual void Alloc(EntityId id) = 0;
 
+	virtual void Free(EntityId id) = 0;
+
+	virtual void AddQuery(IComponentQuery* query) = 0;
+
 	virtual uint32_t NumComponents() const = 0;
 
-	virtual void FrameUpdate(const ECS_Context& ctx, ComponentManager* cm) = 0;
+	virtual bool HasComponent(EntityId id) const = 0;
+
+	virtual void BeginFrame(uint32_t frameIndex) = 0;
+
+	virtual uint32_t NumChunks() const = 0;
+
+	virtual bool IsChunkChangedSince(uint32_t chunk, uint32_t sinceFrame) const = 0;
+
+	// Runs the component's generated shim for one update step ("PreUpdate", "Update" or
+	// "PostUpdate") on every row, nothing when the component has no function for the step
+	virtual void FrameUpdate(const ECS_Context& ctx, ComponentManager* cm, std::string_view step) = 0;
+
+	virtual ComponentTypeId GetTypeId() const = 0;
+
+	virtual const ComponentFunctionTable& GetComponentFunctions() const = 0;
+
+	virtual bool IsDoubleBuffered() const = 0;
+
+	// Brings the current buffer up to date with the previous one at the start of frameIndex
+	virtual void CopyForward(uint32_t frameIndex) = 0;
+
+	virtual void SwapBuffers() = 0;
+
+	// Snapshot support, see snapshot.h. Only trivially copyable components have their rows
+	// saved as raw bytes; the others are restored default constructed on the same entities.
+	virtual bool IsTriviallyCopyable() const = 0;
+
+	virtual uint64_t GetSchemaHash() const = 0;
+
+	virtual uint32_t GetComponentSize() const = 0;
+
+	virtual std::span<const EntityId> GetEntities() const = 0;
+
+	virtual const void* GetRowBytes(bool prevFrame) const = 0;
 
-	virtual std::vector<ComponentTask> GetComponentFunctions() = 0;
+	virtual void Adopt(std::span<const EntityId> entities, const void* rows, const void* prevRows) = 0;
 };
 
+// Components declared @double_buffered keep the previous frame's values in a second buffer.
+// Writers update the current buffer while `in` readers from other systems see the previous one,
+// so readers never wait on writers. SwapBuffers publishes a frame in O(1); CopyForward then
+// brings the new current buffer up to date as a job that runs before the next frame's writers,
+// copying only the chunks changed since the buffers were last made equal.
+template< class T >
+constexpr bool IsDoubleBufferedComponent = requires { T::IsDoubleBuffered(); };
 
+// Components declared @on_change only react to writes: their update steps visit the rows of the
+// chunks changed since the step ran in the previous frame, see ComponentSystem::RunStep.
+template< class T >
+constexpr bool IsChangeDrivenComponent = requires { T::IsChangeDriven(); };
 
+
+
+// Change detection: rows are grouped into chunks of kChunkRows, each stamped with the newest
+// frame that had writable access to any of its rows or that first saw one of them allocated.
+// Consumers remember the frame they last looked at and skip every chunk not changed since.
+// Writable access without a frame (Get, GetAt) is stamped with the next frame to be scheduled,
+// which can only make a chunk look newer than it is, never older.
 template< class T  >
 class ComponentSystem : public IComponentSystem
 {
 public:
+	static constexpr uint32_t kNoRow = UINT32_MAX;
+
 	ComponentSystem(const std::string& name)
 	: mName(name)
+	, mTypeId(GetComponentTypeId(name))
+	, mEntitiesSorted(true)
+	, mCopiedFrame(0)
+	, mNextFrameIndex(1)
     {
     }
 
@@ -158,132 +601,1321 @@ public:
 	}
 
 	virtual void Alloc(EntityId id) {
-		mEntityMap[id.ToInt()] = mData.size();
-		mReverseEntityMap[mData.size()] = id.ToInt();
+		if (id.mIndex >= mRows.size()) {
+			mRows.resize(id.mIndex + 1, kNoRow);
+		}
+		mRows[id.mIndex] = uint32_t(mData.size());
+		if (!mEntities.empty() && mEntities.back().mIndex > id.mIndex) {
+			mEntitiesSorted = false;
+		}
+		mEntities.push_back(id);
 		mData.emplace_back(T());
+		if (IsDoubleBufferedComponent<T>) {
+			mPrevData.emplace_back(T());
+		}
+		const uint32_t row = uint32_t(mData.size() - 1);
+		if (row / kChunkRows >= mChunkVersions.size()) {
+			mChunkVersions.push_back(0);
+		}
+		MarkChanged(row, NextFrameIndex());
+
+		for (IComponentQuery* query : mQueries) {
+			query->OnAlloc(id);
+		}
 	}
 
-	const T* Get(EntityId id) const {
-		uint64_t i = id.ToInt();
-		auto it = mEntityMap.find(i);
-		if (it != mEntityMap.end())
+	// Removes the entity's component by moving the last row into its place. Like Alloc, this
+	// must not run while jobs of a frame are in flight.
+	virtual void Free(EntityId id) {
+		const uint32_t row = FindRow(id);
+		if (row == kNoRow) {
+			return;
+		}
+
+		for (IComponentQuery* query : mQueries) {
+			query->OnFree(id);
+		}
+
+		const uint32_t last = uint32_t(mData.size() - 1);
+		if (row != last) {
+			const EntityId moved = mEntities[last];
+			mData[row] = std::move(mData[last]);
+			if (IsDoubleBufferedComponent<T>) {
+				mPrevData[row] = std::move(mPrevData[last]);
+			}
+			mEntities[row] = moved;
+			mRows[moved.mIndex] = row;
+			mEntitiesSorted = false;
+			MarkChanged(row, NextFrameIndex());
+
+			for (IComponentQuery* query : mQueries) {
+				query->OnRowMoved(this, moved, row);
+			}
+		}
+		mRows[id.mIndex] = kNoRow;
+		mEntities.pop_back();
+		mData.pop_back();
+		if (IsDoubleBufferedComponent<T>) {
+			mPrevData.pop_back();
+		}
+		if (last % kChunkRows == 0) {
+			mChunkVersions.pop_back();
+		}
+	}
+
+	virtual void AddQuery(IComponentQuery* query) {
+		mQueries.push_back(query);
+	}
+
+	virtual void BeginFrame(uint32_t frameIndex) {
+		mNextFrameIndex.store(frameIndex + 1, std::memory_order_relaxed);
+	}
+
+	// Read-only access, from the previous frame's buffer when double buffered
+	const T* GetRead(EntityId id) const {
+		const uint32_t row = FindRow(id);
+		if (row != kNoRow)
 		{
-			uint32_t componentIndex = it->second;
-			return &(mData[componentIndex]);
+			return IsDoubleBufferedComponent<T> ? &(mPrevData[row]) : &(mData[row]);
 		}
 		return nullptr;
 	}
 
+	// Current buffer like the non-const Get, double buffered or not. Readers scheduled against
+	// the previous frame, such as an `in ComponentSystem<T>` parameter, use GetRead.
+	const T* Get(EntityId id) const {
+		const uint32_t row = FindRow(id);
+		return (row != kNoRow) ? &(mData[row]) : nullptr;
+	}
+
 	T* Get(EntityId id) {
-		uint64_t i = id.ToInt();
-		auto it = mEntityMap.find(i);
-		if (it != mEntityMap.end())
+		return GetWrite(id, NextFrameIndex());
+	}
+
+	// Writable access on behalf of a job of frame frameIndex
+	T* GetWrite(EntityId id, uint32_t frameIndex) {
+		const uint32_t row = FindRow(id);
+		if (row != kNoRow)
 		{
-			uint32_t componentIndex = it->second;
-			return &(mData[componentIndex]);
+			MarkChanged(row, frameIndex);
+			return &(mData[row]);
 		}
 		return nullptr;
 	}
 
-	virtual uint32_t	NumComponents() const {
-		return mEntityMap.size();
+	// Array lookup rather than a hash, so generated shims can probe other systems per row
+	uint32_t FindRow(EntityId id) const {
+		if (id.mIndex >= mRows.size()) {
+			return kNoRow;
+		}
+		const uint32_t row = mRows[id.mIndex];
+		if (row == kNoRow || mEntities[row].mCount != id.mCount) {
+			return kNoRow;
+		}
+		return row;
 	}
 
-	virtual void FrameUpdate(const ECS_Context& ctx, ComponentManager* cm) {
-		ECS_Context thisCtx = ctx;
-		const int numComponents = mData.size();
-		for(int iComponent =0; iComponent <numComponents; ++iComponent) {
-			uint64_t id = mReverseEntityMap[iComponent];
-			thisCtx.thisEntityId = EntityId(id);
-			mData[iComponent].CallUpdate(thisCtx, *cm);
-		}
+	T& GetAt(uint32_t row) {
+		return GetWriteAt(row, NextFrameIndex());
 	}
 
-	virtual std::vector<ComponentTask> GetComponentFunctions() {
-		return T::ComponentFunctions();
+	T& GetWriteAt(uint32_t row, uint32_t frameIndex) {
+		MarkChanged(row, frameIndex);
+		return mData[row];
 	}
 
-private:
-	std::string										mName;
-	std::vector<T>									mData;
-	std::unordered_map< uint64_t, uint32_t >		mEntityMap;
-	std::unordered_map< uint32_t, uint64_t >		mReverseEntityMap;
-};
+	// Previous frame's buffer when double buffered, like GetRead
+	const T& GetReadAt(uint32_t row) const {
+		return IsDoubleBufferedComponent<T> ? mPrevData[row] : mData[row];
+	}
 
-class ComponentManager
-{
-public:
-	IComponentSystem* GetSystemByName(const std::string findName) {
-		for (auto sys : mSystems) {
-			if (sys->Name() == findName) {
-				return sys;
-			}
-		}
-		return nullptr;
+	EntityId GetEntityAt(uint32_t row) const {
+		return mEntities[row];
 	}
 
-	template< class T  >
-	ComponentSystem<T>*		GetSystem(const std::string findName) {
-		//const char* findName = TypeName<T>::Get();
-		//if (findName == nullptr) {
-		//	return nullptr;
-		//}
+	// True while rows are in increasing entity order, so two systems can be merge-joined
+	bool IsEntitySorted() const {
+		return mEntitiesSorted;
+	}
 
-		for(auto sys : mSystems) {
-			if (findName == sys->Name()) {
-				return static_cast<ComponentSystem<T>*>(sys);
+	// Rows [begin, end) for a generated Run<Step> shim
+	ComponentRange<T> GetRange(uint32_t begin, uint32_t end) {
+		return ComponentRange<T>(this, mData.data(), mEntities.data(), begin, end);
+	}
+
+	void MarkChanged(uint32_t row, uint32_t frameIndex) {
+		RaiseChangeVersion(mChunkVersions[row / kChunkRows], frameIndex);
+	}
+
+	void MarkRowsChanged(uint32_t begin, uint32_t end, uint32_t frameIndex) {
+		if (begin < end) {
+			for (uint32_t chunk = begin / kChunkRows; chunk <= (end - 1) / kChunkRows; ++chunk) {
+				RaiseChangeVersion(mChunkVersions[chunk], frameIndex);
 			}
 		}
-		return nullptr;
 	}
 
-	void FrameUpdate(const ECS_Context& ctx) {
-		for(auto sys : mSystems) {
-			sys->FrameUpdate(ctx, this);
-		}
+	virtual uint32_t NumChunks() const {
+		return uint32_t(mChunkVersions.size());
 	}
 
-//private:
-	std::vector< IComponentSystem* > mSystems;
-};
+	// Newest frame that changed a row of the chunk, 0 if none ever did
+	uint32_t GetChunkVersion(uint32_t chunk) const {
+		return std::atomic_ref<uint32_t>(const_cast<uint32_t&>(mChunkVersions[chunk])).load(std::memory_order_relaxed);
+	}
 
-template<class C>
-void RegisterComponent(ComponentManager* mgr, const std::string& name) {
-	auto deps = C::ComponentFunctions();
-	auto* cs = new ComponentSystem<C>(name);
-	mgr->mSystems.push_back(cs);
-};
+	virtual bool IsChunkChangedSince(uint32_t chunk, uint32_t sinceFrame) const {
+		return GetChunkVersion(chunk) > sinceFrame;
+	}
 
-class EntityManager
-{
-public:
+	virtual uint32_t	NumComponents() const {
+		return uint32_t(mEntities.size());
+	}
 
-	EntityId	AllocEntity()
-	{
-		// TODO: Free and recycle entity ids
-		EntityId id(mEntities.size(), 1);
-		mEntities.push_back(id);
-		return id;
+	virtual bool HasComponent(EntityId id) const {
+		return FindRow(id) != kNoRow;
 	}
 
-	void	FrameUpdate() {
-		mCtx.deltaTime = 1.0f / 30.0f;
-		mComponentManager.FrameUpdate(mCtx);
+	virtual void FrameUpdate(const ECS_Context& ctx, ComponentManager* cm, std::string_view step) {
+		ECS_Context thisCtx = ctx;
+		if (step == "PreUpdate") {
+			if constexpr (requires { T::RunPreUpdate; }) {
+				RunStep(ctx.frameIndex, [&](const ComponentRange<T>& rows) { T::RunPreUpdate(rows, thisCtx, *cm); });
+			}
+		}
+		else if (step == "Update") {
+			if constexpr (requires { T::RunUpdate; }) {
+				RunStep(ctx.frameIndex, [&](const ComponentRange<T>& rows) { T::RunUpdate(rows, thisCtx, *cm); });
+			}
+		}
+		else if (step == "PostUpdate") {
+			if constexpr (requires { T::RunPostUpdate; }) {
+				RunStep(ctx.frameIndex, [&](const ComponentRange<T>& rows) { T::RunPostUpdate(rows, thisCtx, *cm); });
+			}
+		}
 	}
 
-	ComponentManager*		GetComponentMgr() {
-		return &mComponentManager;
+	// Calls run(rows) with every row, or for an @on_change component with each run of chunks
+	// changed since the step ran in the previous frame. Anything written after that run is
+	// stamped with that frame or a later one, so chunks written earlier in that frame are
+	// visited twice, and none is missed.
+	template< class F >
+	void RunStep(uint32_t frameIndex, const F& run) {
+		const ComponentRange<T> rows = GetRange(0, NumComponents());
+		if constexpr (IsChangeDrivenComponent<T>) {
+			rows.ForEachChangedSince(frameIndex >= 2 ? frameIndex - 2 : 0, run);
+		}
+		else {
+			run(rows);
+		}
 	}
 
-	const ECS_Context&		GetContext() const {
-		return mCtx;
+	virtual ComponentTypeId GetTypeId() const {
+		return mTypeId;
 	}
 
-private:
-	ComponentManager		mComponentManager;
-	ECS_Context				mCtx;
-	std::vector<EntityId>	mEntities;
-};
+	virtual const ComponentFunctionTable& GetComponentFunctions() const {
+		return kFunctions;
+	}
+
+	virtual bool IsDoubleBuffered() const {
+		return IsDoubleBufferedComponent<T>;
+	}
+
+	// After the last CopyForward both buffers held the same rows, and every write since stamped
+	// its chunk with that frame or a later one, so older chunks are still equal in both
+	virtual void CopyForward(uint32_t frameIndex) {
+		if (IsDoubleBufferedComponent<T>) {
+			const uint32_t numRows = uint32_t(mData.size());
+			for (uint32_t chunk = 0; chunk < mChunkVersions.size(); ++chunk) {
+				if (GetChunkVersion(chunk) >= mCopiedFrame) {
+					const uint32_t begin = chunk * kChunkRows;
+					const uint32_t end = std::min(begin + kChunkRows, numRows);
+					std::copy(mPrevData.begin() + begin, mPrevData.begin() + end, mData.begin() + begin);
+				}
+			}
+			mCopiedFrame = frameIndex;
+		}
+	}
+
+	virtual void SwapBuffers() {
+		if (IsDoubleBufferedComponent<T>) {
+			mData.swap(mPrevData);
+		}
+	}
+
+	virtual bool IsTriviallyCopyable() const {
+		return std::is_trivially_copyable_v<T>;
+	}
+
+	virtual uint64_t GetSchemaHash() const {
+		return GetComponentSchemaHash<T>();
+	}
+
+	virtual uint32_t GetComponentSize() const {
+		return uint32_t(sizeof(T));
+	}
+
+	virtual std::span<const EntityId> GetEntities() const {
+		return mEntities;
+	}
+
+	// Null when there is no such buffer or the rows are not trivially copyable
+	virtual const void* GetRowBytes(bool prevFrame) const {
+		if (!std::is_trivially_copyable_v<T> || (prevFrame && !IsDoubleBufferedComponent<T>)) {
+			return nullptr;
+		}
+		return prevFrame ? mPrevData.data() : mData.data();
+	}
+
+	// Replaces every row with one per entity, copying each buffer in one go from rows / prevRows
+	// when given (they must hold trivially copyable T), default constructing it otherwise
+	virtual void Adopt(std::span<const EntityId> entities, const void* rows, const void* prevRows) {
+		const size_t numRows = entities.size();
+		mEntities.assign(entities.begin(), entities.end());
+		AdoptRows(mData, rows, numRows);
+		if (IsDoubleBufferedComponent<T>) {
+			AdoptRows(mPrevData, prevRows, numRows);
+		}
+
+		mRows.clear();
+		for (uint32_t row = 0; row < numRows; ++row) {
+			const uint32_t index = mEntities[row].mIndex;
+			if (index >= mRows.size()) {
+				mRows.resize(index + 1, kNoRow);
+			}
+			mRows[index] = row;
+		}
+		mEntitiesSorted = std::is_sorted(mEntities.begin(), mEntities.end(), [](const EntityId& a, const EntityId& b) { return a.mIndex < b.mIndex; });
+		mChunkVersions.assign((numRows + kChunkRows - 1) / kChunkRows, NextFrameIndex());
+		mCopiedFrame = 0;
+
+		for (IComponentQuery* query : mQueries) {
+			query->OnReset();
+		}
+	}
+
+private:
+	static constexpr ComponentFunctionTable			kFunctions = GetComponentFunctionTable<T>();
+
+	std::string										mName;
+	ComponentTypeId									mTypeId;
+	std::vector<T>									mData;
+	std::vector<T>									mPrevData;		// previous frame, only used when double buffered
+	std::vector<uint32_t>							mRows;			// entity index -> row, kNoRow when the entity has none
+	std::vector<EntityId>							mEntities;		// row -> entity
+	bool											mEntitiesSorted;
+	std::vector<uint32_t>							mChunkVersions;	// chunk -> newest frame that changed it
+	uint32_t										mCopiedFrame;	// frame of the last CopyForward, 0 before the first
+	std::atomic<uint32_t>							mNextFrameIndex;	// stamp for writes that don't name a frame
+	std::vector<IComponentQuery*>					mQueries;		// told about every Alloc and Free
+
+	uint32_t NextFrameIndex() const {
+		return mNextFrameIndex.load(std::memory_order_relaxed);
+	}
+
+	static void AdoptRows(std::vector<T>& data, const void* rows, size_t numRows) {
+		if constexpr (std::is_trivially_copyable_v<T>) {
+			if (rows != nullptr) {
+				const T* first = static_cast<const T*>(rows);
+				data.assign(first, first + numRows);
+				return;
+			}
+		}
+		data.clear();
+		data.reserve(numRows);
+		for (size_t row = 0; row < numRows; ++row) {
+			data.emplace_back(T());
+		}
+	}
+};
+
+// How a generated Run<Step> shim joins its rows with the components of the same entity in
+// other systems. Entities missing any of the joined components are skipped.
+enum class JoinStrategy
+{
+	Probe,			// iterate the rows, look each entity up in the other systems
+	DriveOther,		// iterate the smaller other system, look each entity up in this one
+	Merge,			// both systems in entity order, walk them together
+};
+
+template< class T, class... Others >
+JoinStrategy PlanJoin(const ComponentRange<T>& rows, ComponentSystem<Others>*... others) {
+	if constexpr (sizeof...(Others) == 1) {
+		const ComponentSystem<T>* self = rows.GetSystem();
+		const bool wholeSystem = (rows.GetBegin() == 0 && rows.GetEnd() == self->NumComponents());
+		const uint32_t otherSize = (others->NumComponents(), ...);
+		if (wholeSystem && otherSize < rows.Size()) {
+			return JoinStrategy::DriveOther;
+		}
+		if (self->IsEntitySorted() && (others->IsEntitySorted() && ...)) {
+			return JoinStrategy::Merge;
+		}
+	}
+	return JoinStrategy::Probe;
+}
+
+// Calls f(row, otherRow...) for every row of the range whose entity has a component in each
+// of the other systems, where otherRow is that component's row for GetAt / GetReadAt.
+template< class T, class F, class... Others >
+void JoinRows(const ComponentRange<T>& rows, const F& f, ComponentSystem<Others>*... others) {
+	constexpr uint32_t kNoRow = ComponentSystem<T>::kNoRow;
+
+	if (((others == nullptr) || ...)) {
+		return;		// system not registered, so no entity has the component
+	}
+
+	if constexpr (sizeof...(Others) == 1) {
+		const JoinStrategy strategy = PlanJoin(rows, others...);
+		if (strategy == JoinStrategy::DriveOther) {
+			const ComponentSystem<T>* self = rows.GetSystem();
+			([&](ComponentSystem<Others>* other) {
+				const uint32_t numOther = other->NumComponents();
+				for (uint32_t otherRow = 0; otherRow < numOther; ++otherRow) {
+					const uint32_t row = self->FindRow(other->GetEntityAt(otherRow));
+					if (row != kNoRow) {
+						f(rows.GetRow(row), otherRow);
+					}
+				}
+			}(others), ...);
+			return;
+		}
+		if (strategy == JoinStrategy::Merge) {
+			([&](ComponentSystem<Others>* other) {
+				const uint32_t numOther = other->NumComponents();
+				if (rows.Size() == 0) {
+					return;
+				}
+
+				// first row of the other system at or after the range's first entity
+				const uint32_t firstIndex = rows.GetRow(rows.GetBegin()).mEntity.mIndex;
+				uint32_t otherRow = 0;
+				uint32_t otherEnd = numOther;
+				while (otherRow < otherEnd) {
+					const uint32_t mid = otherRow + (otherEnd - otherRow) / 2;
+					if (other->GetEntityAt(mid).mIndex < firstIndex) {
+						otherRow = mid + 1;
+					}
+					else {
+						otherEnd = mid;
+					}
+				}
+
+				for (uint32_t row = rows.GetBegin(); row < rows.GetEnd(); ++row) {
+					const ComponentRow<T> r = rows.GetRow(row);
+					while (otherRow < numOther && other->GetEntityAt(otherRow).mIndex < r.mEntity.mIndex) {
+						++otherRow;
+					}
+					if (otherRow == numOther) {
+						break;
+					}
+					const EntityId otherEntity = other->GetEntityAt(otherRow);
+					if (otherEntity.mIndex == r.mEntity.mIndex && otherEntity.mCount == r.mEntity.mCount) {
+						f(r, otherRow);
+					}
+				}
+			}(others), ...);
+			return;
+		}
+	}
+
+	for (uint32_t row = rows.GetBegin(); row < rows.GetEnd(); ++row) {
+		const ComponentRow<T> r = rows.GetRow(row);
+		if constexpr (sizeof...(Others) == 0) {
+			f(r);
+		}
+		else {
+			const std::array<uint32_t, sizeof...(Others)> otherRows = { others->FindRow(r.mEntity)... };
+			if (std::find(otherRows.begin(), otherRows.end(), kNoRow) == otherRows.end()) {
+				std::apply([&](auto... otherRow) { f(r, otherRow...); }, otherRows);
+			}
+		}
+	}
+}
+
+// Entities that have every one of the components Ts, cached with their row in each system.
+// The systems report Alloc, Free and the rows Free moves, so the cache is updated as entities
+// change instead of being recomputed, and iterating it costs one step per match however large
+// the systems are. Obtained from ComponentManager::Query, which keeps one per signature.
+template< class... Ts >
+class ComponentQuery : public IComponentQuery
+{
+public:
+	static constexpr uint32_t kNoSlot = UINT32_MAX;
+	using Rows = std::array<uint32_t, sizeof...(Ts)>;
+
+	ComponentQuery(ComponentSystem<Ts>*... systems)
+	: mSystems(systems...)
+	{
+		OnReset();
+	}
+
+	uint32_t Size() const {
+		return uint32_t(mEntities.size());
+	}
+
+	EntityId GetEntityAt(uint32_t slot) const {
+		return mEntities[slot];
+	}
+
+	// Row of the entity in each system, in the order of Ts, for GetAt / GetReadAt
+	const Rows& GetRowsAt(uint32_t slot) const {
+		return mRows[slot];
+	}
+
+	// Calls f(entity, Ts&...) for every match
+	template< class F >
+	void ForEach(const F& f) {
+		ForEach(f, std::index_sequence_for<Ts...>());
+	}
+
+	// Calls f(entity, const Ts&...) for every match, with what `in` readers see, so the previous
+	// frame's component when double buffered
+	template< class F >
+	void ForEach(const F& f) const {
+		ForEachRead(f, std::index_sequence_for<Ts...>());
+	}
+
+	virtual void OnAlloc(EntityId id) {
+		if (FindSlot(id) != kNoSlot) {
+			return;
+		}
+		const Rows rows = FindRows(id, std::index_sequence_for<Ts...>());
+		if (std::find(rows.begin(), rows.end(), kNoSlot) != rows.end()) {
+			return;
+		}
+		if (id.mIndex >= mSlots.size()) {
+			mSlots.resize(id.mIndex + 1, kNoSlot);
+		}
+		mSlots[id.mIndex] = uint32_t(mEntities.size());
+		mEntities.push_back(id);
+		mRows.push_back(rows);
+	}
+
+	virtual void OnFree(EntityId id) {
+		const uint32_t slot = FindSlot(id);
+		if (slot == kNoSlot) {
+			return;
+		}
+		const uint32_t last = uint32_t(mEntities.size() - 1);
+		mEntities[slot] = mEntities[last];
+		mRows[slot] = mRows[last];
+		mSlots[mEntities[slot].mIndex] = slot;
+		mSlots[id.mIndex] = kNoSlot;
+		mEntities.pop_back();
+		mRows.pop_back();
+	}
+
+	virtual void OnRowMoved(IComponentSystem* sys, EntityId id, uint32_t row) {
+		const uint32_t slot = FindSlot(id);
+		if (slot == kNoSlot) {
+			return;
+		}
+		OnRowMoved(sys, mRows[slot], row, std::index_sequence_for<Ts...>());
+	}
+
+	virtual void OnReset() {
+		mEntities.clear();
+		mRows.clear();
+		mSlots.clear();
+
+		// every match is an entity of the smallest system
+		std::apply([&](ComponentSystem<Ts>*... systems) {
+			uint32_t smallest = UINT32_MAX;
+			((smallest = std::min(smallest, systems->NumComponents())), ...);
+			bool seeded = false;
+			([&](ComponentSystem<Ts>* sys) {
+				if (!seeded && sys->NumComponents() == smallest) {
+					seeded = true;
+					for (uint32_t row = 0; row < smallest; ++row) {
+						OnAlloc(sys->GetEntityAt(row));
+					}
+				}
+			}(systems), ...);
+		}, mSystems);
+	}
+
+private:
+	uint32_t FindSlot(EntityId id) const {
+		if (id.mIndex >= mSlots.size()) {
+			return kNoSlot;
+		}
+		const uint32_t slot = mSlots[id.mIndex];
+		if (slot == kNoSlot || mEntities[slot].mCount != id.mCount) {
+			return kNoSlot;
+		}
+		return slot;
+	}
+
+	template< size_t... I >
+	Rows FindRows(EntityId id, std::index_sequence<I...>) const {
+		static_assert(((ComponentSystem<Ts>::kNoRow == kNoSlot) && ...), "missing rows are told apart by kNoSlot");
+		return Rows{ std::get<I>(mSystems)->FindRow(id)... };
+	}
+
+	template< size_t... I >
+	void OnRowMoved(IComponentSystem* sys, Rows& rows, uint32_t row, std::index_sequence<I...>) {
+		([&](ComponentSystem<Ts>* other, uint32_t& otherRow) {
+			if (other == sys) {
+				otherRow = row;
+			}
+		}(std::get<I>(mSystems), rows[I]), ...);
+	}
+
+	template< class F, size_t... I >
+	void ForEach(const F& f, std::index_sequence<I...>) {
+		for (uint32_t slot = 0; slot < Size(); ++slot) {
+			f(mEntities[slot], std::get<I>(mSystems)->GetAt(mRows[slot][I])...);
+		}
+	}
+
+	template< class F, size_t... I >
+	void ForEachRead(const F& f, std::index_sequence<I...>) const {
+		for (uint32_t slot = 0; slot < Size(); ++slot) {
+			f(mEntities[slot], std::get<I>(mSystems)->GetReadAt(mRows[slot][I])...);
+		}
+	}
+
+	std::tuple<ComponentSystem<Ts>*...>		mSystems;
+	std::vector<EntityId>					mEntities;	// slot -> entity
+	std::vector<Rows>						mRows;		// slot -> row in each system
+	std::vector<uint32_t>					mSlots;		// entity index -> slot, kNoSlot when not a match
+};
+
+// Nearest entity found by a SpatialIndex query, with its indexed position
+struct SpatialHit
+{
+	EntityId	mEntity;
+	float		mX = 0.0f;
+	float		mY = 0.0f;
+	float		mDistanceSq = 0.0f;
+
+	// False when no entity was within range
+	bool Found() const {
+		return mEntity.mIndex != UINT32_MAX;
+	}
+};
+
+// Rebuilt by the frame driver in three scheduled steps: Prepare, then Gather for every slice in
+// parallel, then Build. Readers only ever see the grid the last Build published.
+class ISpatialIndex
+{
+public:
+	static constexpr uint32_t kNumSlices = 4;
+
+	virtual IComponentSystem* GetSystem() const = 0;
+
+	// Starts a rebuild for frame frameIndex, which indexes the positions its `in` readers see
+	virtual void Prepare(uint32_t frameIndex) = 0;
+
+	// Copies the positions of one slice of the rows, skipping chunks not changed since the last rebuild
+	virtual void Gather(uint32_t slice) = 0;
+
+	// Sorts the gathered positions into grid cells, unless none of them changed
+	virtual void Build() = 0;
+};
+
+template< class T >
+constexpr bool HasComponentPosition = requires (const T& c) { float(c.x); float(c.y); };
+
+// Uniform grid over the x / y members of every component of type T, for nearest-entity queries
+// without a scan of every component. Positions are those `in` readers of T see, so the previous
+// frame's for a double buffered T. Gather only rereads the chunks whose change version moved
+// since the last rebuild, and Build is skipped when nothing moved. Registered with
+// RegisterSpatialIndex and read by systems through an `in SpatialIndex<T>` parameter.
+template< class T >
+class SpatialIndex : public ISpatialIndex
+{
+public:
+	static_assert(HasComponentPosition<T>, "a spatial index needs float x and y members");
+
+	static constexpr float kPointsPerCell = 2.0f;
+	static constexpr uint32_t kMaxCellsPerAxis = 1024;
+
+	SpatialIndex(ComponentSystem<T>* sys)
+	: mSystem(sys)
+	{
+	}
+
+	uint32_t Size() const {
+		return uint32_t(mEntities.size());
+	}
+
+	// Closest indexed entity to (x, y) no further than maxDistance. Visits the cells in rings
+	// around the query's cell and stops once no unvisited cell can hold anything closer.
+	SpatialHit Nearest(float x, float y, float maxDistance = std::numeric_limits<float>::infinity()) const {
+		SpatialHit hit;
+		hit.mDistanceSq = maxDistance * maxDistance;
+		if (mEntities.empty()) {
+			return hit;
+		}
+
+		const int32_t cellX = CellCoord(x, mMinX, mDimX);
+		const int32_t cellY = CellCoord(y, mMinY, mDimY);
+		auto visit = [&](int32_t cx, int32_t cy) {
+			const uint32_t cell = uint32_t(cy) * mDimX + uint32_t(cx);
+			for (uint32_t slot = mCellStart[cell]; slot < mCellStart[cell + 1]; ++slot) {
+				const float dx = mX[slot] - x;
+				const float dy = mY[slot] - y;
+				const float distanceSq = dx * dx + dy * dy;
+				if (distanceSq < hit.mDistanceSq || (!hit.Found() && distanceSq <= hit.mDistanceSq)) {
+					hit.mEntity = mEntities[slot];
+					hit.mX = mX[slot];
+					hit.mY = mY[slot];
+					hit.mDistanceSq = distanceSq;
+					if (distanceSq == 0.0f) {
+						return;		// can't be beaten
+					}
+				}
+			}
+		};
+
+		const int32_t dimX = int32_t(mDimX);
+		const int32_t dimY = int32_t(mDimY);
+		for (int32_t ring = 0; ; ++ring) {
+			const int32_t x0 = cellX - ring;
+			const int32_t x1 = cellX + ring;
+			const int32_t y0 = cellY - ring;
+			const int32_t y1 = cellY + ring;
+			for (int32_t cy = std::max(y0, 0); cy <= std::min(y1, dimY - 1); ++cy) {
+				if (cy == y0 || cy == y1) {
+					for (int32_t cx = std::max(x0, 0); cx <= std::min(x1, dimX - 1); ++cx) {
+						visit(cx, cy);
+					}
+				}
+				else {
+					if (x0 >= 0) {
+						visit(x0, cy);
+					}
+					if (x1 < dimX) {
+						visit(x1, cy);
+					}
+				}
+			}
+
+			// every cell outside the rings visited so far is at least margin away
+			float margin = std::numeric_limits<float>::infinity();
+			if (x0 > 0) {
+				margin = std::min(margin, x - (mMinX + float(x0) * mCellSize));
+			}
+			if (x1 < dimX - 1) {
+				margin = std::min(margin, mMinX + float(x1 + 1) * mCellSize - x);
+			}
+			if (y0 > 0) {
+				margin = std::min(margin, y - (mMinY + float(y0) * mCellSize));
+			}
+			if (y1 < dimY - 1) {
+				margin = std::min(margin, mMinY + float(y1 + 1) * mCellSize - y);
+			}
+			if (margin == std::numeric_limits<float>::infinity() || (margin > 0.0f && margin * margin >= hit.mDistanceSq)) {
+				return hit;
+			}
+		}
+	}
+
+	virtual IComponentSystem* GetSystem() const {
+		return mSystem;
+	}
+
+	virtual void Prepare(uint32_t frameIndex) {
+		// the frame's readers see the positions as of the end of the previous frame
+		const uint32_t coveredFrame = frameIndex - 1;
+		const uint32_t numRows = mSystem->NumComponents();
+		mFullRefresh = !mBuilt || numRows != mRowEntities.size() || coveredFrame < mCoveredFrame;
+		mRefreshSince = mCoveredFrame;
+		mCoveredFrame = coveredFrame;
+		mRowEntities.resize(numRows);
+		mRowX.resize(numRows);
+		mRowY.resize(numRows);
+	}
+
+	virtual void Gather(uint32_t slice) {
+		const uint32_t numRows = uint32_t(mRowEntities.size());
+		const uint32_t numChunks = (numRows + kChunkRows - 1) / kChunkRows;
+		const uint32_t beginRow = std::min(slice * numChunks / kNumSlices * kChunkRows, numRows);
+		const uint32_t endRow = std::min((slice + 1) * numChunks / kNumSlices * kChunkRows, numRows);
+
+		Slice& s = mSlices[slice];
+		s.mChanged = false;
+		for (uint32_t chunkRow = beginRow; chunkRow < endRow; chunkRow += kChunkRows) {
+			if (!mFullRefresh && !mSystem->IsChunkChangedSince(chunkRow / kChunkRows, mRefreshSince)) {
+				continue;
+			}
+			for (uint32_t row = chunkRow; row < std::min(chunkRow + kChunkRows, endRow); ++row) {
+				const T& c = mSystem->GetReadAt(row);
+				mRowEntities[row] = mSystem->GetEntityAt(row);
+				mRowX[row] = float(c.x);
+				mRowY[row] = float(c.y);
+			}
+			s.mChanged = true;
+		}
+
+		if (s.mChanged || mFullRefresh) {
+			s.mMinX = s.mMinY = std::numeric_limits<float>::infinity();
+			s.mMaxX = s.mMaxY = -std::numeric_limits<float>::infinity();
+			for (uint32_t row = beginRow; row < endRow; ++row) {
+				s.mMinX = std::min(s.mMinX, mRowX[row]);
+				s.mMaxX = std::max(s.mMaxX, mRowX[row]);
+				s.mMinY = std::min(s.mMinY, mRowY[row]);
+				s.mMaxY = std::max(s.mMaxY, mRowY[row]);
+			}
+		}
+	}
+
+	virtual void Build() {
+		bool changed = mFullRefresh;
+		for (const Slice& s : mSlices) {
+			changed = changed || s.mChanged;
+		}
+		mBuilt = true;
+		if (!changed) {
+			return;
+		}
+
+		float minX = std::numeric_limits<float>::infinity();
+		float minY = minX;
+		float maxX = -minX;
+		float maxY = -minX;
+		for (const Slice& s : mSlices) {
+			minX = std::min(minX, s.mMinX);
+			minY = std::min(minY, s.mMinY);
+			maxX = std::max(maxX, s.mMaxX);
+			maxY = std::max(maxY, s.mMaxY);
+		}
+		if (!std::isfinite(maxX - minX) || !std::isfinite(maxY - minY)) {
+			// nothing indexed, or positions at infinity, which all share the edge cells
+			minX = minY = maxX = maxY = 0.0f;
+		}
+
+		// square cells holding about kPointsPerCell entities each, as far as the bounds allow
+		const uint32_t numRows = uint32_t(mRowEntities.size());
+		const float width = maxX - minX;
+		const float height = maxY - minY;
+		const float numCells = std::max(1.0f, float(numRows) / kPointsPerCell);
+		const float extent = std::max(width, height);
+		const float cellSize = std::max({ std::sqrt(width * height / numCells), extent / numCells, extent / float(kMaxCellsPerAxis) });
+		mMinX = minX;
+		mMinY = minY;
+		mCellSize = (cellSize > 0.0f) ? cellSize : 1.0f;
+		mDimX = std::min(uint32_t(width / mCellSize) + 1, kMaxCellsPerAxis);
+		mDimY = std::min(uint32_t(height / mCellSize) + 1, kMaxCellsPerAxis);
+
+		// counting sort of the rows by cell
+		mCellStart.assign(size_t(mDimX) * mDimY + 1, 0);
+		mRowCells.resize(numRows);
+		for (uint32_t row = 0; row < numRows; ++row) {
+			const uint32_t cell = uint32_t(CellCoord(mRowY[row], mMinY, mDimY)) * mDimX + uint32_t(CellCoord(mRowX[row], mMinX, mDimX));
+			mRowCells[row] = cell;
+			++mCellStart[cell + 1];
+		}
+		for (size_t cell = 1; cell < mCellStart.size(); ++cell) {
+			mCellStart[cell] += mCellStart[cell - 1];
+		}
+		mCellCursor.assign(mCellStart.begin(), mCellStart.end() - 1);
+		mEntities.resize(numRows);
+		mX.resize(numRows);
+		mY.resize(numRows);
+		for (uint32_t row = 0; row < numRows; ++row) {
+			const uint32_t slot = mCellCursor[mRowCells[row]]++;
+			mEntities[slot] = mRowEntities[row];
+			mX[slot] = mRowX[row];
+			mY[slot] = mRowY[row];
+		}
+	}
+
+private:
+	static constexpr uint32_t kChunkRows = IComponentSystem::kChunkRows;
+
+	// Rows gathered by one Gather job and their bounds, kept while none of them change
+	struct Slice
+	{
+		bool	mChanged = false;
+		float	mMinX = 0.0f;
+		float	mMinY = 0.0f;
+		float	mMaxX = 0.0f;
+		float	mMaxY = 0.0f;
+	};
+
+	// Cell along one axis, positions outside the grid (or NaN) go to the nearest edge cell
+	int32_t CellCoord(float v, float min, uint32_t dim) const {
+		const float f = (v - min) / mCellSize;
+		if (!(f > 0.0f)) {
+			return 0;
+		}
+		return f < float(dim) ? std::min(int32_t(f), int32_t(dim) - 1) : int32_t(dim) - 1;
+	}
+
+	ComponentSystem<T>*						mSystem;
+	bool									mBuilt = false;
+	bool									mFullRefresh = true;	// rows were added, removed or rewound since the last rebuild
+	uint32_t								mRefreshSince = 0;		// chunks changed after this frame are gathered again
+	uint32_t								mCoveredFrame = 0;		// newest frame whose writes are gathered
+	std::array<Slice, kNumSlices>			mSlices;
+
+	// row -> gathered entity and position, written by Gather
+	std::vector<EntityId>					mRowEntities;
+	std::vector<float>						mRowX;
+	std::vector<float>						mRowY;
+	std::vector<uint32_t>					mRowCells;
+
+	// the grid readers query, written by Build: cell -> first slot, slot -> entity and position
+	float									mMinX = 0.0f;
+	float									mMinY = 0.0f;
+	float									mCellSize = 1.0f;
+	uint32_t								mDimX = 0;
+	uint32_t								mDimY = 0;
+	std::vector<uint32_t>					mCellStart;
+	std::vector<uint32_t>					mCellCursor;
+	std::vector<EntityId>					mEntities;
+	std::vector<float>						mX;
+	std::vector<float>						mY;
+};
+
+class ITransformHierarchy;
+class IEventChannel;
+template< class T >
+class EventChannel;
+
+class ComponentManager
+{
+public:
+	IComponentSystem* GetSystemByName(const std::string findName) {
+		for (auto sys : mSystems) {
+			if (sys->Name() == findName) {
+				return sys;
+			}
+		}
+		return nullptr;
+	}
+
+	IComponentSystem* GetSystemById(ComponentTypeId id) {
+		for (auto sys : mSystems) {
+			if (sys->GetTypeId() == id) {
+				return sys;
+			}
+		}
+		return nullptr;
+	}
+
+	template< class T  >
+	ComponentSystem<T>*		GetSystem(const std::string findName) {
+		//const char* findName = TypeName<T>::Get();
+		//if (findName == nullptr) {
+		//	return nullptr;
+		//}
+
+		for(auto sys : mSystems) {
+			if (findName == sys->Name()) {
+				return static_cast<ComponentSystem<T>*>(sys);
+			}
+		}
+		return nullptr;
+	}
+
+	// System of component type T, whatever name it was registered under
+	template< class T >
+	ComponentSystem<T>*		FindSystem() {
+		for (auto sys : mSystems) {
+			if (auto* found = dynamic_cast<ComponentSystem<T>*>(sys)) {
+				return found;
+			}
+		}
+		return nullptr;
+	}
+
+	// Cached entities having all of the components Ts, built on first use and kept up to date
+	// by the systems from then on. Null when one of the components is not registered.
+	template< class... Ts >
+	ComponentQuery<Ts...>*	Query() {
+		for (IComponentQuery* query : mQueries) {
+			if (auto* found = dynamic_cast<ComponentQuery<Ts...>*>(query)) {
+				return found;
+			}
+		}
+		if (((FindSystem<Ts>() == nullptr) || ...)) {
+			return nullptr;
+		}
+		auto* query = new ComponentQuery<Ts...>(FindSystem<Ts>()...);
+		(FindSystem<Ts>()->AddQuery(query), ...);
+		mQueries.push_back(query);
+		return query;
+	}
+
+	// Query for systems taking an `in ComponentQuery<Ts...>` parameter, null unless registered
+	// with RegisterQuery, since building one from a job would race with the others
+	template< class... Ts >
+	ComponentQuery<Ts...>*	GetQuery() {
+		for (IComponentQuery* query : mQueries) {
+			if (auto* found = dynamic_cast<ComponentQuery<Ts...>*>(query)) {
+				return found;
+			}
+		}
+		return nullptr;
+	}
+
+	// Spatial index over the positions of component T, null unless registered with RegisterSpatialIndex
+	template< class T >
+	SpatialIndex<T>*		GetSpatialIndex() {
+		for (ISpatialIndex* index : mSpatialIndices) {
+			if (auto* found = dynamic_cast<SpatialIndex<T>*>(index)) {
+				return found;
+			}
+		}
+		return nullptr;
+	}
+
+	// Channel of events of type T, null unless registered with RegisterEventStream
+	template< class T >
+	EventChannel<T>*		GetEventChannel() {
+		for (IEventChannel* channel : mEventChannels) {
+			if (auto* found = dynamic_cast<EventChannel<T>*>(channel)) {
+				return found;
+			}
+		}
+		return nullptr;
+	}
+
+	void FrameUpdate(const ECS_Context& ctx) {
+		for(auto sys : mSystems) {
+			sys->FrameUpdate(ctx, this, "Update");
+		}
+	}
+
+	// Called once a frame is numbered and before any of its jobs are scheduled
+	void BeginFrame(uint32_t frameIndex) {
+		for (auto sys : mSystems) {
+			sys->BeginFrame(frameIndex);
+		}
+	}
+
+//private:
+	std::vector< IComponentSystem* > mSystems;
+	std::vector< IComponentQuery* > mQueries;
+	std::vector< ISpatialIndex* > mSpatialIndices;
+	std::vector< ITransformHierarchy* > mHierarchies;
+	std::vector< IEventChannel* > mEventChannels;
+};
+
+template<class C>
+void RegisterComponent(ComponentManager* mgr, const std::string& name) {
+	static_assert(IsValidComponentFunctionTable(GetComponentFunctionTable<C>()), "invalid generated component function table");
+	auto* cs = new ComponentSystem<C>(name);
+	mgr->mSystems.push_back(cs);
+};
+
+// Indexes the positions of every component of type T, which must be registered already, for
+// systems taking an `in SpatialIndex<T>` parameter
+template<class T>
+void RegisterSpatialIndex(ComponentManager* mgr) {
+	ComponentSystem<T>* sys = mgr->FindSystem<T>();
+	assert(sys != nullptr);
+	mgr->mSpatialIndices.push_back(new SpatialIndex<T>(sys));
+};
+
+// Caches the entities having every one of the components Ts, which must be registered already,
+// for systems taking an `in ComponentQuery<Ts...>` parameter
+template< class... Ts >
+void RegisterQuery(ComponentManager* mgr) {
+	[[maybe_unused]] ComponentQuery<Ts...>* query = mgr->Query<Ts...>();
+	assert(query != nullptr);
+}
+
+class EntityManager
+{
+public:
+
+	EntityId	AllocEntity()
+	{
+		// TODO: Free and recycle entity ids
+		EntityId id(mEntities.size(), 1);
+		mEntities.push_back(id);
+		return id;
+	}
+
+	// Frees every component of the entity, its id is not reused
+	void	FreeEntity(EntityId id)
+	{
+		if (!IsAlive(id)) {
+			return;
+		}
+		for (IComponentSystem* sys : mComponentManager.mSystems) {
+			sys->Free(id);
+		}
+		mEntities[id.mIndex] = EntityId();
+		mFreedEntities.push_back(id.mIndex);
+	}
+
+	bool	IsAlive(EntityId id) const
+	{
+		return id.mIndex < mEntities.size() && mEntities[id.mIndex].mIndex == id.mIndex && mEntities[id.mIndex].mCount == id.mCount;
+	}
+
+	void	FrameUpdate() {
+		mCtx.deltaTime = 1.0f / 30.0f;
+		BeginFrame();
+		mComponentManager.FrameUpdate(mCtx);
+	}
+
+	// Numbers the next frame, from 1, and returns the context its jobs should copy
+	const ECS_Context&		BeginFrame() {
+		++mCtx.frameIndex;
+		mComponentManager.BeginFrame(mCtx.frameIndex);
+		return mCtx;
+	}
+
+	ComponentManager*		GetComponentMgr() {
+		return &mComponentManager;
+	}
+
+	const ECS_Context&		GetContext() const {
+		return mCtx;
+	}
+
+	std::span<const EntityId>	GetEntities() const {
+		return mEntities;
+	}
+
+	// Index of every entity freed, in order, for recording what changed
+	std::span<const uint32_t>	GetFreedEntities() const {
+		return mFreedEntities;
+	}
+
+	// Restores the allocated entities and frame counter, e.g. from a snapshot. The component
+	// systems are restored separately.
+	void	AdoptEntities(std::span<const EntityId> entities, uint32_t frameIndex) {
+		mEntities.assign(entities.begin(), entities.end());
+		mFreedEntities.clear();
+		mCtx.frameIndex = frameIndex;
+		mComponentManager.BeginFrame(frameIndex);
+	}
+
+private:
+	ComponentManager		mComponentManager;
+	ECS_Context				mCtx;
+	std::vector<EntityId>	mEntities;
+	std::vector<uint32_t>	mFreedEntities;
+};
+
+// Structural changes recorded by the jobs of a frame and applied by Playback at a point where no
+// job touches any component. Every worker slot records into its own buffer, so recording never
+// locks, and Playback applies the commands ordered by (task, entity being updated, sequence),
+// which doesn't depend on which worker ran what, so the resulting entity ids are deterministic.
+class EntityCommands
+{
+public:
+	EntityCommands(uint32_t numWorkerSlots)
+	: mBuffers(numWorkerSlots)
+	{
+		assert(numWorkerSlots <= kMaxWorkerSlots);
+	}
+
+	// Placeholder id until playback; commands recorded with it later apply to the new entity
+	EntityId CreateEntity(const ECS_Context& ctx) {
+		Buffer& buffer = mBuffers[ctx.workerSlot];
+		const EntityId pending((ctx.workerSlot << kPendingWorkerShift) | buffer.mNumCreated++, 0);
+		Add(ctx, Command::Type::Create, pending);
+		return pending;
+	}
+
+	void DestroyEntity(const ECS_Context& ctx, EntityId id) {
+		Add(ctx, Command::Type::Destroy, id);
+	}
+
+	// Adds a default constructed component, or for trivially copyable T one copied from value
+	template< class T >
+	void AddComponent(const ECS_Context& ctx, EntityId id, const T* value) {
+		Command& command = Add(ctx, Command::Type::Add, id);
+		command.mFindSystem = &FindSystem<T>;
+		if constexpr (std::is_trivially_copyable_v<T>) {
+			if (value == nullptr) {
+				return;
+			}
+			std::vector<char>& values = mBuffers[ctx.workerSlot].mValues;
+			command.mValueOffset = uint32_t(values.size());
+			values.insert(values.end(), reinterpret_cast<const char*>(value), reinterpret_cast<const char*>(value) + sizeof(T));
+			command.mSetValue = &SetValue<T>;
+		}
+	}
+
+	template< class T >
+	void RemoveComponent(const ECS_Context& ctx, EntityId id) {
+		Command& command = Add(ctx, Command::Type::Remove, id);
+		command.mFindSystem = &FindSystem<T>;
+	}
+
+	bool IsEmpty() const {
+		for (const Buffer& buffer : mBuffers) {
+			if (!buffer.mCommands.empty()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Applies and clears every recorded command. Must run while no job touches any component.
+	// Its temporaries are scratch memory of ctx's frame.
+	void Playback(EntityManager& entityManager, const ECS_Context& ctx) {
+		size_t numCommands = 0;
+		for (const Buffer& buffer : mBuffers) {
+			numCommands += buffer.mCommands.size();
+		}
+		std::span<const Command*> ordered = ctx.AllocScratchArray<const Command*>(numCommands);
+		size_t numOrdered = 0;
+		for (const Buffer& buffer : mBuffers) {
+			for (const Command& command : buffer.mCommands) {
+				ordered[numOrdered++] = &command;
+			}
+		}
+		std::sort(ordered.begin(), ordered.end(), [](const Command* a, const Command* b) {
+			return std::tie(a->mTaskOrder, a->mSource, a->mSequence) < std::tie(b->mTaskOrder, b->mSource, b->mSequence);
+		});
+
+		// entities created through each slot's placeholders, the slot's first at firstCreated[slot]
+		std::span<uint32_t> firstCreated = ctx.AllocScratchArray<uint32_t>(mBuffers.size());
+		uint32_t numCreated = 0;
+		for (size_t slot = 0; slot < mBuffers.size(); ++slot) {
+			firstCreated[slot] = numCreated;
+			numCreated += mBuffers[slot].mNumCreated;
+		}
+		std::span<EntityId> created = ctx.AllocScratchArray<EntityId>(numCreated);
+		auto findCreated = [&](EntityId pending) -> EntityId* {
+			const uint32_t slot = pending.mIndex >> kPendingWorkerShift;
+			const uint32_t local = pending.mIndex & ((1u << kPendingWorkerShift) - 1);
+			return (slot < mBuffers.size() && local < mBuffers[slot].mNumCreated) ? &created[firstCreated[slot] + local] : nullptr;
+		};
+		auto resolve = [&](EntityId id) {
+			if (id.mCount != 0 || id.mIndex == UINT32_MAX) {
+				return id;
+			}
+			const EntityId* found = findCreated(id);
+			return found ? *found : EntityId();
+		};
+
+		ComponentManager& cm = *entityManager.GetComponentMgr();
+		for (const Command* command : ordered) {
+			const EntityId id = resolve(command->mEntity);
+			switch (command->mType) {
+			case Command::Type::Create:
+				*findCreated(command->mEntity) = entityManager.AllocEntity();
+				break;
+			case Command::Type::Destroy:
+				entityManager.FreeEntity(id);
+				break;
+			case Command::Type::Add:
+				if (IComponentSystem* sys = command->mFindSystem(cm); sys != nullptr && entityManager.IsAlive(id)) {
+					if (!sys->HasComponent(id)) {
+						sys->Alloc(id);
+					}
+					if (command->mSetValue != nullptr) {
+						command->mSetValue(sys, id, mBuffers[command->mSlot].mValues.data() + command->mValueOffset);
+					}
+				}
+				break;
+			case Command::Type::Remove:
+				if (IComponentSystem* sys = command->mFindSystem(cm)) {
+					sys->Free(id);
+				}
+				break;
+			}
+		}
+
+		for (Buffer& buffer : mBuffers) {
+			buffer.mCommands.clear();
+			buffer.mValues.clear();
+			buffer.mNumCreated = 0;
+		}
+	}
+
+private:
+	static constexpr uint32_t kPendingWorkerShift = 24;
+	static constexpr uint32_t kMaxWorkerSlots = 1u << (32 - kPendingWorkerShift);
+
+	struct Command
+	{
+		enum class Type : uint8_t { Create, Destroy, Add, Remove };
+
+		uint32_t			mTaskOrder;
+		uint32_t			mSource;		// index of the entity being updated when recorded
+		uint32_t			mSequence;		// within the task and source
+		uint32_t			mSlot;
+		Type				mType;
+		EntityId			mEntity;
+		IComponentSystem*	(*mFindSystem)(ComponentManager& cm);
+		void				(*mSetValue)(IComponentSystem* sys, EntityId id, const char* value);
+		uint32_t			mValueOffset;
+	};
+
+	// aligned so workers recording side by side don't share cache lines
+	struct alignas(64) Buffer
+	{
+		std::vector<Command>	mCommands;
+		std::vector<char>		mValues;		// component values of Add commands
+		uint32_t				mNumCreated = 0;
+		uint32_t				mLastTaskOrder = UINT32_MAX;
+		uint32_t				mLastSource = UINT32_MAX;
+		uint32_t				mNextSequence = 0;
+	};
+
+	Command& Add(const ECS_Context& ctx, Command::Type type, EntityId id) {
+		Buffer& buffer = mBuffers[ctx.workerSlot];
+		if (buffer.mLastTaskOrder != ctx.taskOrder || buffer.mLastSource != ctx.thisEntityId.mIndex) {
+			buffer.mLastTaskOrder = ctx.taskOrder;
+			buffer.mLastSource = ctx.thisEntityId.mIndex;
+			buffer.mNextSequence = 0;
+		}
+		Command command = {};
+		command.mTaskOrder = ctx.taskOrder;
+		command.mSource = ctx.thisEntityId.mIndex;
+		command.mSequence = buffer.mNextSequence++;
+		command.mSlot = ctx.workerSlot;
+		command.mType = type;
+		command.mEntity = id;
+		buffer.mCommands.push_back(command);
+		return buffer.mCommands.back();
+	}
+
+	template< class T >
+	static IComponentSystem* FindSystem(ComponentManager& cm) {
+		return cm.FindSystem<T>();
+	}
+
+	template< class T >
+	static void SetValue(IComponentSystem* sys, EntityId id, const char* value) {
+		ComponentSystem<T>* typed = static_cast<ComponentSystem<T>*>(sys);
+		memcpy(&typed->GetAt(typed->FindRow(id)), value, sizeof(T));
+	}
+
+	std::vector<Buffer>		mBuffers;		// one per worker slot
+};
+
+inline EntityId ECS_Context::DeferCreateEntity() const {
+	assert(commands != nullptr);
+	return commands->CreateEntity(*this);
+}
+
+inline void ECS_Context::DeferDestroyEntity(EntityId id) const {
+	assert(commands != nullptr);
+	commands->DestroyEntity(*this, id);
+}
+
+template< class T >
+void ECS_Context::DeferAddComponent(EntityId id) const {
+	assert(commands != nullptr);
+	commands->AddComponent<T>(*this, id, nullptr);
+}
+
+template< class T >
+void ECS_Context::DeferAddComponent(EntityId id, const T& value) const {
+	static_assert(std::is_trivially_copyable_v<T>, "deferred component values are copied as bytes");
+	assert(commands != nullptr);
+	commands->AddComponent<T>(*this, id, &value);
+}
+
+template< class T >
+void ECS_Context::DeferRemoveComponent(EntityId id) const {
+	assert(commands != nullptr);
+	commands->RemoveComponent<T>(*this, id);
+}
 
 //
 //class TestComponentA {
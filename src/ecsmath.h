@@ -0,0 +1,355 @@
+#pragma once
+
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ECS_MATH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ECS_MATH_AVX2                                 ///< MSVC emits AVX2 intrinsics without a target switch.
+#else
+#define ECS_MATH_AVX2 __attribute__((target("avx2")))  ///< Compiles one function for AVX2, the rest of the file stays SSE2.
+#endif
+#endif
+
+// Approximations shared by the scalar, SSE2 and AVX2 code paths. Every path evaluates the same
+// polynomials with the same operations in the same order and no fused multiply-add, so a batch
+// kernel returns bit for bit what the scalar function returns for each element, on any CPU.
+//   sin / cos    |error| < 2e-7 for |x| < 10, growing with the reduction to 1.2e-6 at |x| = 1e5
+//   atan2        |error| < 1.2e-5 rad (Abramowitz & Stegun 4.4.49)
+namespace ecs_math
+{
+	enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+	constexpr float kPi = 3.14159265358979f;
+	constexpr float kHalfPi = 1.57079632679490f;
+	constexpr float kInvTwoPi = 0.159154943091895f;
+	constexpr float kTwoPiHi = 6.28125f;				// few mantissa bits, so k * kTwoPiHi is exact
+	constexpr float kTwoPiLo = 0.00193530717958648f;	// 2 pi - kTwoPiHi
+
+	constexpr float kSin3 = -1.0f / 6.0f;
+	constexpr float kSin5 = 1.0f / 120.0f;
+	constexpr float kSin7 = -1.0f / 5040.0f;
+	constexpr float kSin9 = 1.0f / 362880.0f;
+	constexpr float kSin11 = -1.0f / 39916800.0f;
+
+	constexpr float kAtan1 = 0.9998660f;
+	constexpr float kAtan3 = -0.3302995f;
+	constexpr float kAtan5 = 0.1801410f;
+	constexpr float kAtan7 = -0.0851330f;
+	constexpr float kAtan9 = 0.0208351f;
+
+	// Best level both the CPU and the OS support, detected once
+	inline SimdLevel DetectSimdLevel() {
+#ifdef ECS_MATH_X86
+		static const SimdLevel level = []() {
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			const int maxLeaf = info[0];
+			__cpuid(info, 1);
+			const bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+			bool avx2 = false;
+			if (osSavesAvx && maxLeaf >= 7) {
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+			return avx2 ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#else
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#endif
+		}();
+		return level;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	// Odd polynomial for sin on [-pi/2, pi/2]
+	inline float SinPoly(float a) {
+		const float a2 = a * a;
+		return a + a * (a2 * (kSin3 + a2 * (kSin5 + a2 * (kSin7 + a2 * (kSin9 + a2 * kSin11)))));
+	}
+
+	// x - k 2pi, k the nearest integer to x / 2pi, ties to even like the SIMD conversions. The
+	// result can overshoot [-pi, pi] by a rounding error. Adding zero turns k = -0 into +0 as cvtps2dq does.
+	inline float ReduceAngle(float x) {
+		const float k = std::nearbyint(x * kInvTwoPi) + 0.0f;
+		return (x - k * kTwoPiHi) - k * kTwoPiLo;
+	}
+
+	inline float Sin(float x) {
+		const float r = ReduceAngle(x);
+		const float a = std::fabs(r);
+		const float s = SinPoly(std::fmin(a, kPi - a));		// sin(|r|), negative past pi
+		return std::signbit(r) ? -s : s;
+	}
+
+	inline float Cos(float x) {
+		return SinPoly(kHalfPi - std::fabs(ReduceAngle(x)));
+	}
+
+	inline float Atan2(float y, float x) {
+		const float ax = std::fabs(x);
+		const float ay = std::fabs(y);
+		const float hi = std::fmax(ax, ay);
+		const float a = (hi > 0.0f) ? std::fmin(ax, ay) / hi : 0.0f;
+		const float s = a * a;
+		float r = a * (kAtan1 + s * (kAtan3 + s * (kAtan5 + s * (kAtan7 + s * kAtan9))));
+		r = (ay > ax) ? kHalfPi - r : r;
+		r = (x < 0.0f) ? kPi - r : r;
+		return std::copysign(r, y);
+	}
+
+	enum class Kernel { Sin, Cos, Atan2, LookAt };
+
+	// out[i] = kernel(a[i], b[i], ...) for the elements [begin, end), the scalar tail of every path
+	inline void RunScalar(Kernel kernel, const float* a, const float* b, const float* c, const float* d, float* out, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			switch (kernel) {
+			case Kernel::Sin: out[i] = Sin(a[i]); break;
+			case Kernel::Cos: out[i] = Cos(a[i]); break;
+			case Kernel::Atan2: out[i] = Atan2(a[i], b[i]); break;
+			case Kernel::LookAt: out[i] = Atan2(b[i] - d[i], a[i] - c[i]); break;
+			}
+		}
+	}
+
+#ifdef ECS_MATH_X86
+	// SSE2, 4 lanes. There is no SSE2 round, cvtps2dq rounds to nearest even like nearbyint.
+	namespace sse
+	{
+		inline __m128 Abs(__m128 v) {
+			return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+		}
+
+		// magnitude of v with the sign of s, like std::copysign
+		inline __m128 CopySign(__m128 v, __m128 s) {
+			const __m128 sign = _mm_set1_ps(-0.0f);
+			return _mm_or_ps(_mm_andnot_ps(sign, v), _mm_and_ps(sign, s));
+		}
+
+		// v with its sign flipped where s is negative
+		inline __m128 MulSign(__m128 v, __m128 s) {
+			return _mm_xor_ps(v, _mm_and_ps(_mm_set1_ps(-0.0f), s));
+		}
+
+		inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		}
+
+		inline __m128 SinPoly(__m128 a) {
+			const __m128 a2 = _mm_mul_ps(a, a);
+			__m128 p = _mm_add_ps(_mm_set1_ps(kSin9), _mm_mul_ps(a2, _mm_set1_ps(kSin11)));
+			p = _mm_add_ps(_mm_set1_ps(kSin7), _mm_mul_ps(a2, p));
+			p = _mm_add_ps(_mm_set1_ps(kSin5), _mm_mul_ps(a2, p));
+			p = _mm_add_ps(_mm_set1_ps(kSin3), _mm_mul_ps(a2, p));
+			return _mm_add_ps(a, _mm_mul_ps(a, _mm_mul_ps(a2, p)));
+		}
+
+		inline __m128 ReduceAngle(__m128 x) {
+			const __m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(kInvTwoPi))));
+			return _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(kTwoPiHi))), _mm_mul_ps(k, _mm_set1_ps(kTwoPiLo)));
+		}
+
+		inline __m128 Sin(__m128 x) {
+			const __m128 r = ReduceAngle(x);
+			const __m128 a = Abs(r);
+			return MulSign(SinPoly(_mm_min_ps(a, _mm_sub_ps(_mm_set1_ps(kPi), a))), r);
+		}
+
+		inline __m128 Cos(__m128 x) {
+			return SinPoly(_mm_sub_ps(_mm_set1_ps(kHalfPi), Abs(ReduceAngle(x))));
+		}
+
+		inline __m128 Atan2(__m128 y, __m128 x) {
+			const __m128 ax = Abs(x);
+			const __m128 ay = Abs(y);
+			const __m128 hi = _mm_max_ps(ax, ay);
+			const __m128 a = _mm_and_ps(_mm_cmpgt_ps(hi, _mm_setzero_ps()), _mm_div_ps(_mm_min_ps(ax, ay), hi));
+			const __m128 s = _mm_mul_ps(a, a);
+			__m128 p = _mm_add_ps(_mm_set1_ps(kAtan7), _mm_mul_ps(s, _mm_set1_ps(kAtan9)));
+			p = _mm_add_ps(_mm_set1_ps(kAtan5), _mm_mul_ps(s, p));
+			p = _mm_add_ps(_mm_set1_ps(kAtan3), _mm_mul_ps(s, p));
+			p = _mm_add_ps(_mm_set1_ps(kAtan1), _mm_mul_ps(s, p));
+			__m128 r = _mm_mul_ps(a, p);
+			r = Select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(kHalfPi), r), r);
+			r = Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(kPi), r), r);
+			return CopySign(r, y);
+		}
+
+		inline void Run(Kernel kernel, const float* a, const float* b, const float* c, const float* d, float* out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				__m128 v;
+				switch (kernel) {
+				case Kernel::Sin: v = Sin(_mm_loadu_ps(a + i)); break;
+				case Kernel::Cos: v = Cos(_mm_loadu_ps(a + i)); break;
+				case Kernel::Atan2: v = Atan2(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)); break;
+				default: v = Atan2(_mm_sub_ps(_mm_loadu_ps(b + i), _mm_loadu_ps(d + i)), _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(c + i))); break;
+				}
+				_mm_storeu_ps(out + i, v);
+			}
+			RunScalar(kernel, a, b, c, d, out, i, n);
+		}
+	}
+
+	// AVX2, 8 lanes, the same operations as the SSE2 path
+	namespace avx2
+	{
+		ECS_MATH_AVX2 inline __m256 Abs(__m256 v) {
+			return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+		}
+
+		ECS_MATH_AVX2 inline __m256 CopySign(__m256 v, __m256 s) {
+			const __m256 sign = _mm256_set1_ps(-0.0f);
+			return _mm256_or_ps(_mm256_andnot_ps(sign, v), _mm256_and_ps(sign, s));
+		}
+
+		ECS_MATH_AVX2 inline __m256 MulSign(__m256 v, __m256 s) {
+			return _mm256_xor_ps(v, _mm256_and_ps(_mm256_set1_ps(-0.0f), s));
+		}
+
+		ECS_MATH_AVX2 inline __m256 SinPoly(__m256 a) {
+			const __m256 a2 = _mm256_mul_ps(a, a);
+			__m256 p = _mm256_add_ps(_mm256_set1_ps(kSin9), _mm256_mul_ps(a2, _mm256_set1_ps(kSin11)));
+			p = _mm256_add_ps(_mm256_set1_ps(kSin7), _mm256_mul_ps(a2, p));
+			p = _mm256_add_ps(_mm256_set1_ps(kSin5), _mm256_mul_ps(a2, p));
+			p = _mm256_add_ps(_mm256_set1_ps(kSin3), _mm256_mul_ps(a2, p));
+			return _mm256_add_ps(a, _mm256_mul_ps(a, _mm256_mul_ps(a2, p)));
+		}
+
+		ECS_MATH_AVX2 inline __m256 ReduceAngle(__m256 x) {
+			const __m256 k = _mm256_add_ps(_mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(kInvTwoPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), _mm256_setzero_ps());
+			return _mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(kTwoPiHi))), _mm256_mul_ps(k, _mm256_set1_ps(kTwoPiLo)));
+		}
+
+		ECS_MATH_AVX2 inline __m256 Sin(__m256 x) {
+			const __m256 r = ReduceAngle(x);
+			const __m256 a = Abs(r);
+			return MulSign(SinPoly(_mm256_min_ps(a, _mm256_sub_ps(_mm256_set1_ps(kPi), a))), r);
+		}
+
+		ECS_MATH_AVX2 inline __m256 Cos(__m256 x) {
+			return SinPoly(_mm256_sub_ps(_mm256_set1_ps(kHalfPi), Abs(ReduceAngle(x))));
+		}
+
+		ECS_MATH_AVX2 inline __m256 Atan2(__m256 y, __m256 x) {
+			const __m256 ax = Abs(x);
+			const __m256 ay = Abs(y);
+			const __m256 hi = _mm256_max_ps(ax, ay);
+			const __m256 a = _mm256_and_ps(_mm256_cmp_ps(hi, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_div_ps(_mm256_min_ps(ax, ay), hi));
+			const __m256 s = _mm256_mul_ps(a, a);
+			__m256 p = _mm256_add_ps(_mm256_set1_ps(kAtan7), _mm256_mul_ps(s, _mm256_set1_ps(kAtan9)));
+			p = _mm256_add_ps(_mm256_set1_ps(kAtan5), _mm256_mul_ps(s, p));
+			p = _mm256_add_ps(_mm256_set1_ps(kAtan3), _mm256_mul_ps(s, p));
+			p = _mm256_add_ps(_mm256_set1_ps(kAtan1), _mm256_mul_ps(s, p));
+			__m256 r = _mm256_mul_ps(a, p);
+			r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kHalfPi), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+			r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kPi), r), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+			return CopySign(r, y);
+		}
+
+		ECS_MATH_AVX2 inline void Run(Kernel kernel, const float* a, const float* b, const float* c, const float* d, float* out, size_t n) {
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256 v;
+				switch (kernel) {
+				case Kernel::Sin: v = Sin(_mm256_loadu_ps(a + i)); break;
+				case Kernel::Cos: v = Cos(_mm256_loadu_ps(a + i)); break;
+				case Kernel::Atan2: v = Atan2(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)); break;
+				default: v = Atan2(_mm256_sub_ps(_mm256_loadu_ps(b + i), _mm256_loadu_ps(d + i)), _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(c + i))); break;
+				}
+				_mm256_storeu_ps(out + i, v);
+			}
+			RunScalar(kernel, a, b, c, d, out, i, n);
+		}
+	}
+#endif
+}
+
+// Pure math for component updates, safe to call from any job. The N variants work on SoA
+// spans of equal length, writing one result per element to out, which may alias an input, and
+// pick the widest code path the CPU supports.
+class ECS_Math {
+public:
+	ECS_Math()
+	: mLevel(ecs_math::DetectSimdLevel())
+	{
+	}
+
+	// Heading, in radians, that points from (bx, by) toward (ax, ay)
+	float lookAt(float ax, float ay, float bx, float by) const {
+		return ecs_math::Atan2(ay - by, ax - bx);
+	}
+
+	// x of the unit vector along heading r
+	float forward(float r) const {
+		return ecs_math::Cos(r);
+	}
+
+	float sin(float x) const {
+		return ecs_math::Sin(x);
+	}
+
+	float cos(float x) const {
+		return ecs_math::Cos(x);
+	}
+
+	float atan2(float y, float x) const {
+		return ecs_math::Atan2(y, x);
+	}
+
+	void lookAtN(std::span<const float> ax, std::span<const float> ay, std::span<const float> bx, std::span<const float> by, std::span<float> out) const {
+		assert(ay.size() == ax.size() && bx.size() == ax.size() && by.size() == ax.size() && out.size() == ax.size());
+		Run(ecs_math::Kernel::LookAt, ax.data(), ay.data(), bx.data(), by.data(), out.data(), out.size());
+	}
+
+	void forwardN(std::span<const float> r, std::span<float> out) const {
+		cosN(r, out);
+	}
+
+	void sinN(std::span<const float> x, std::span<float> out) const {
+		assert(out.size() == x.size());
+		Run(ecs_math::Kernel::Sin, x.data(), nullptr, nullptr, nullptr, out.data(), out.size());
+	}
+
+	void cosN(std::span<const float> x, std::span<float> out) const {
+		assert(out.size() == x.size());
+		Run(ecs_math::Kernel::Cos, x.data(), nullptr, nullptr, nullptr, out.data(), out.size());
+	}
+
+	void atan2N(std::span<const float> y, std::span<const float> x, std::span<float> out) const {
+		assert(x.size() == y.size() && out.size() == y.size());
+		Run(ecs_math::Kernel::Atan2, y.data(), x.data(), nullptr, nullptr, out.data(), out.size());
+	}
+
+	ecs_math::SimdLevel getSimdLevel() const {
+		return mLevel;
+	}
+
+	// Restricts the N variants to a narrower code path, e.g. to compare them. Wider than the
+	// CPU supports is clamped.
+	void setSimdLevel(ecs_math::SimdLevel level) {
+		mLevel = (level < ecs_math::DetectSimdLevel()) ? level : ecs_math::DetectSimdLevel();
+	}
+
+private:
+	void Run(ecs_math::Kernel kernel, const float* a, const float* b, const float* c, const float* d, float* out, size_t n) const {
+		switch (mLevel) {
+#ifdef ECS_MATH_X86
+		case ecs_math::SimdLevel::AVX2: ecs_math::avx2::Run(kernel, a, b, c, d, out, n); break;
+		case ecs_math::SimdLevel::SSE2: ecs_math::sse::Run(kernel, a, b, c, d, out, n); break;
+#endif
+		default: ecs_math::RunScalar(kernel, a, b, c, d, out, 0, n); break;
+		}
+	}
+
+	ecs_math::SimdLevel		mLevel;
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+#include "component.h"
+
+// Typed messages between systems that share no component. A producer system takes an
+// `inout events : EventStream<T>` parameter and emits into its worker's own buffer, so
+// producers running side by side never contend. After every update step the frame driver
+// schedules Publish, which merges the buffers in program order into one contiguous array, and a
+// consumer system taking `in events : EventStream<T>` iterates the events published by the
+// earlier update steps of its frame. Published events are dropped when the next frame publishes.
+class IEventChannel
+{
+public:
+	virtual const std::string& Name() const = 0;
+
+	virtual ComponentTypeId GetTypeId() const = 0;
+
+	// Sizes the per-worker buffers, before any frame runs
+	virtual void SetWorkerSlotCount(uint32_t numWorkerSlots) = 0;
+
+	// Moves the events emitted since the last Publish behind the ones already published this frame
+	virtual void Publish(uint32_t frameIndex) = 0;
+};
+
+template< class T >
+class EventChannel;
+
+// What a system's EventStream<T> parameter is bound to for one job: the worker's buffer of a
+// channel for a producer, the published events for a consumer. A consumer's parameter is `in`,
+// which leaves it no Emit, and a producer sees no events.
+template< class T >
+class EventStream
+{
+public:
+	void Emit(const T& event) {
+		assert(mChannel != nullptr);
+		mChannel->Emit(mWorkerSlot, mTaskOrder, mStarted, event);
+	}
+
+	std::span<const T> Events() const {
+		return mEvents;
+	}
+
+	const T* begin() const {
+		return mEvents.data();
+	}
+
+	const T* end() const {
+		return mEvents.data() + mEvents.size();
+	}
+
+	size_t size() const {
+		return mEvents.size();
+	}
+
+	bool empty() const {
+		return mEvents.empty();
+	}
+
+private:
+	friend class EventChannel<T>;
+
+	EventChannel<T>*	mChannel = nullptr;		// null for a consumer
+	uint32_t			mWorkerSlot = 0;
+	uint32_t			mTaskOrder = 0;
+	bool				mStarted = false;		// a run of this job's events is open in the worker's buffer
+	std::span<const T>	mEvents;
+};
+
+template< class T >
+class EventChannel : public IEventChannel
+{
+public:
+	EventChannel(const std::string& name)
+	: mName(name)
+	, mTypeId(GetComponentTypeId(name))
+	{
+	}
+
+	virtual const std::string& Name() const {
+		return mName;
+	}
+
+	virtual ComponentTypeId GetTypeId() const {
+		return mTypeId;
+	}
+
+	virtual void SetWorkerSlotCount(uint32_t numWorkerSlots) {
+		mWorkers.resize(numWorkerSlots);
+	}
+
+	// Stream for a producer job running on ctx's worker
+	EventStream<T> Writer(const ECS_Context& ctx) {
+		assert(ctx.workerSlot < mWorkers.size());
+		EventStream<T> stream;
+		stream.mChannel = this;
+		stream.mWorkerSlot = ctx.workerSlot;
+		stream.mTaskOrder = ctx.taskOrder;
+		return stream;
+	}
+
+	// Stream for a consumer job, valid until the next Publish
+	EventStream<T> Reader() const {
+		EventStream<T> stream;
+		stream.mEvents = mPublished;
+		return stream;
+	}
+
+	virtual void Publish(uint32_t frameIndex) {
+		if (frameIndex != mPublishedFrame) {
+			mPublished.clear();
+			mPublishedFrame = frameIndex;
+		}
+
+		// the order workers ran jobs in varies, the order the jobs were scheduled in doesn't
+		mMerge.clear();
+		for (Worker& worker : mWorkers) {
+			for (size_t i = 0; i < worker.mRuns.size(); ++i) {
+				const size_t end = (i + 1 < worker.mRuns.size()) ? worker.mRuns[i + 1].mBegin : worker.mEvents.size();
+				mMerge.push_back({ worker.mRuns[i].mTaskOrder, &worker, worker.mRuns[i].mBegin, end });
+			}
+		}
+		std::stable_sort(mMerge.begin(), mMerge.end(), [](const Span& a, const Span& b) {
+			return a.mTaskOrder < b.mTaskOrder;
+		});
+		for (const Span& span : mMerge) {
+			mPublished.insert(mPublished.end(), span.mWorker->mEvents.begin() + span.mBegin, span.mWorker->mEvents.begin() + span.mEnd);
+		}
+
+		for (Worker& worker : mWorkers) {
+			worker.mEvents.clear();
+			worker.mRuns.clear();
+		}
+	}
+
+private:
+	friend class EventStream<T>;
+
+	// Events one job emitted, from mBegin up to the next run of the same worker
+	struct Run
+	{
+		uint32_t	mTaskOrder;
+		size_t		mBegin;
+	};
+
+	// aligned so workers emitting side by side don't share cache lines
+	struct alignas(64) Worker
+	{
+		std::vector<T>		mEvents;
+		std::vector<Run>	mRuns;
+	};
+
+	struct Span
+	{
+		uint32_t		mTaskOrder;
+		const Worker*	mWorker;
+		size_t			mBegin;
+		size_t			mEnd;
+	};
+
+	void Emit(uint32_t workerSlot, uint32_t taskOrder, bool& started, const T& event) {
+		Worker& worker = mWorkers[workerSlot];
+		if (!started) {
+			worker.mRuns.push_back({ taskOrder, worker.mEvents.size() });
+			started = true;
+		}
+		worker.mEvents.push_back(event);
+	}
+
+	std::string				mName;
+	ComponentTypeId			mTypeId;
+	std::vector<Worker>		mWorkers;				// one per worker slot
+	std::vector<Span>		mMerge;
+	std::vector<T>			mPublished;
+	uint32_t				mPublishedFrame = UINT32_MAX;
+};
+
+// Adds a channel for events of type T, named like the type so generated EventStream<T>
+// parameters find it
+template< class T >
+void RegisterEventStream(ComponentManager* mgr, const std::string& name) {
+	mgr->mEventChannels.push_back(new EventChannel<T>(name));
+}
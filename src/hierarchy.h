@@ -0,0 +1,326 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+#include "component.h"
+
+// Parent / child placement: every entity with a node component (TNode: parent, x, y, r) and a
+// world transform (TWorld: x, y, r) gets its world transform from its parent's world transform
+// combined with the node's local offset. The world transform of a child is owned by the
+// hierarchy, anything else writing it is overwritten the next time the child is recomputed.
+//
+// Nodes are kept in flat arrays sorted by depth, so propagation is a loop per level with no
+// recursion or pointer chasing, and the frame driver runs every level as a parallel-for:
+//   Begin                  re-sorts the nodes when the structure changed
+//   PropagateLevel(l, s)   slice s of level l, for the levels the driver scheduled in parallel
+//   PropagateFrom(l)       every level from l on, one after another
+// A node is only recomputed when its local offset changed (by chunk change version), its
+// root parent's world transform changed (by value) or its parent was recomputed.
+class ITransformHierarchy
+{
+public:
+	static constexpr uint32_t kNumSlices = 4;
+	static constexpr uint32_t kMaxParallelLevels = 16;
+
+	virtual IComponentSystem* GetNodeSystem() const = 0;
+
+	virtual IComponentSystem* GetWorldSystem() const = 0;
+
+	// Levels worth scheduling in parallel, from the depth found by the last Begin. Deeper levels
+	// found meanwhile are still propagated, by PropagateFrom.
+	virtual uint32_t GetParallelLevels() const = 0;
+
+	// Gives child a node under parent, allocating the node if needed. Like Alloc, this must not
+	// run while jobs of a frame are in flight.
+	virtual void Attach(EntityId child, EntityId parent) = 0;
+
+	virtual void Begin(uint32_t frameIndex) = 0;
+
+	virtual void PropagateLevel(uint32_t level, uint32_t slice) = 0;
+
+	virtual void PropagateFrom(uint32_t level) = 0;
+};
+
+template< class TNode, class TWorld >
+class TransformHierarchy : public ITransformHierarchy, public IComponentQuery
+{
+public:
+	static_assert(!IsDoubleBufferedComponent<TWorld>, "children read their parent's world transform as soon as it is written");
+
+	static constexpr uint32_t kNoSlot = UINT32_MAX;
+	static constexpr uint32_t kNoRow = ComponentSystem<TWorld>::kNoRow;
+
+	TransformHierarchy(ComponentSystem<TNode>* nodes, ComponentSystem<TWorld>* world)
+	: mNodeSystem(nodes)
+	, mWorldSystem(world)
+	{
+	}
+
+	virtual IComponentSystem* GetNodeSystem() const {
+		return mNodeSystem;
+	}
+
+	virtual IComponentSystem* GetWorldSystem() const {
+		return mWorldSystem;
+	}
+
+	virtual uint32_t GetParallelLevels() const {
+		return mParallelLevels.load(std::memory_order_relaxed);
+	}
+
+	virtual void Attach(EntityId child, EntityId parent) {
+		if (!mNodeSystem->HasComponent(child)) {
+			mNodeSystem->Alloc(child);
+		}
+		mNodeSystem->Get(child)->parent = parent;
+		mStructureChanged = true;
+	}
+
+	virtual void Begin(uint32_t frameIndex) {
+		mFrameIndex = frameIndex;
+		mChangedSince = mLastFrame;
+		mLastFrame = frameIndex;
+		mRecomputeAll = false;
+
+		// a reparented node only shows as a change in its chunk
+		const uint32_t numNodes = mNodeSystem->NumComponents();
+		for (uint32_t chunk = 0; !mStructureChanged && chunk < mNodeSystem->NumChunks(); ++chunk) {
+			if (!mNodeSystem->IsChunkChangedSince(chunk, mChangedSince)) {
+				continue;
+			}
+			const uint32_t end = std::min((chunk + 1) * kChunkRows, numNodes);
+			for (uint32_t row = chunk * kChunkRows; row < end; ++row) {
+				if (!IsSameEntity(mNodeSystem->GetReadAt(row).parent, mNodeParents[row])) {
+					mStructureChanged = true;
+					break;
+				}
+			}
+		}
+
+		if (mStructureChanged) {
+			Sort();
+			mStructureChanged = false;
+			mRecomputeAll = true;
+		}
+	}
+
+	virtual void PropagateLevel(uint32_t level, uint32_t slice) {
+		if (level + 1 >= mLevelStart.size()) {
+			return;
+		}
+		const uint32_t begin = mLevelStart[level];
+		const uint32_t count = mLevelStart[level + 1] - begin;
+		const uint32_t end = begin + (slice + 1) * count / kNumSlices;
+		for (uint32_t slot = begin + slice * count / kNumSlices; slot < end; ++slot) {
+			Propagate(slot);
+		}
+	}
+
+	virtual void PropagateFrom(uint32_t level) {
+		if (level + 1 >= mLevelStart.size()) {
+			return;
+		}
+		for (uint32_t slot = mLevelStart[level]; slot < mLevelStart.back(); ++slot) {
+			Propagate(slot);
+		}
+	}
+
+	// Any row moving in either system invalidates the rows the sorted nodes point at
+	virtual void OnAlloc(EntityId) {
+		mStructureChanged = true;
+	}
+
+	virtual void OnFree(EntityId) {
+		mStructureChanged = true;
+	}
+
+	virtual void OnRowMoved(IComponentSystem*, EntityId, uint32_t) {
+		mStructureChanged = true;
+	}
+
+	virtual void OnReset() {
+		mStructureChanged = true;
+	}
+
+private:
+	static constexpr uint32_t kChunkRows = IComponentSystem::kChunkRows;
+	static constexpr uint32_t kUnknown = UINT32_MAX;		// depths while sorting
+	static constexpr uint32_t kVisiting = UINT32_MAX - 1;
+	static constexpr uint32_t kUnplaced = UINT32_MAX - 2;	// no world transform, or part of a cycle
+
+	// Last world transform a depth 0 node saw of its parent outside the hierarchy
+	struct RootParent
+	{
+		float	mX = 0.0f;
+		float	mY = 0.0f;
+		float	mR = 0.0f;
+	};
+
+	static bool IsSameEntity(EntityId a, EntityId b) {
+		return a.mIndex == b.mIndex && a.mCount == b.mCount;
+	}
+
+	// Depth of every node, then a counting sort of the nodes into one run of slots per depth
+	void Sort() {
+		const uint32_t numNodes = mNodeSystem->NumComponents();
+		mNodeParents.resize(numNodes);
+		for (uint32_t row = 0; row < numNodes; ++row) {
+			mNodeParents[row] = mNodeSystem->GetReadAt(row).parent;
+		}
+
+		// walk up from every node to one of known depth, then assign depths on the way back down.
+		// Nodes without a world transform and nodes in a cycle are unplaced, and a node whose
+		// parent is unplaced is placed at depth 0.
+		std::vector<uint32_t> depths(numNodes, kUnknown);
+		std::vector<uint32_t> chain;
+		uint32_t numLevels = 0;
+		for (uint32_t row = 0; row < numNodes; ++row) {
+			uint32_t at = row;
+			while (depths[at] == kUnknown) {
+				if (mWorldSystem->FindRow(mNodeSystem->GetEntityAt(at)) == kNoRow) {
+					depths[at] = kUnplaced;
+					break;
+				}
+				const uint32_t parentRow = mNodeSystem->FindRow(mNodeParents[at]);
+				if (parentRow == kNoRow) {
+					depths[at] = 0;
+					break;
+				}
+				depths[at] = kVisiting;
+				chain.push_back(at);
+				at = parentRow;
+			}
+			if (depths[at] == kVisiting) {
+				const size_t cycle = size_t(std::find(chain.begin(), chain.end(), at) - chain.begin());
+				for (size_t i = cycle; i < chain.size(); ++i) {
+					depths[chain[i]] = kUnplaced;
+				}
+				chain.resize(cycle);
+			}
+			uint32_t parentDepth = depths[at];
+			while (!chain.empty()) {
+				parentDepth = depths[chain.back()] = (parentDepth == kUnplaced) ? 0 : parentDepth + 1;
+				chain.pop_back();
+			}
+			if (depths[row] != kUnplaced) {
+				numLevels = std::max(numLevels, depths[row] + 1);
+			}
+		}
+
+		mLevelStart.assign(numLevels + 1, 0);
+		for (uint32_t row = 0; row < numNodes; ++row) {
+			if (depths[row] != kUnplaced) {
+				++mLevelStart[depths[row] + 1];
+			}
+		}
+		for (uint32_t level = 1; level <= numLevels; ++level) {
+			mLevelStart[level] += mLevelStart[level - 1];
+		}
+
+		const uint32_t numSlots = mLevelStart.back();
+		std::vector<uint32_t> cursor(mLevelStart.begin(), mLevelStart.end() - 1);
+		std::vector<uint32_t> slotOfRow(numNodes, kNoSlot);
+		mSlotNodeRows.resize(numSlots);
+		for (uint32_t row = 0; row < numNodes; ++row) {
+			if (depths[row] != kUnplaced) {
+				const uint32_t slot = cursor[depths[row]]++;
+				mSlotNodeRows[slot] = row;
+				slotOfRow[row] = slot;
+			}
+		}
+
+		mSlotWorldRows.resize(numSlots);
+		mSlotParents.resize(numSlots);
+		mSlotRootRows.resize(numSlots);
+		mSlotRootParents.assign(numSlots, RootParent());
+		mSlotRecomputed.assign(numSlots, 0);
+		for (uint32_t slot = 0; slot < numSlots; ++slot) {
+			const uint32_t row = mSlotNodeRows[slot];
+			const uint32_t parentRow = mNodeSystem->FindRow(mNodeParents[row]);
+			mSlotWorldRows[slot] = mWorldSystem->FindRow(mNodeSystem->GetEntityAt(row));
+			mSlotParents[slot] = (parentRow != kNoRow) ? slotOfRow[parentRow] : kNoSlot;
+			mSlotRootRows[slot] = (mSlotParents[slot] == kNoSlot) ? mWorldSystem->FindRow(mNodeParents[row]) : kNoRow;
+		}
+
+		mParallelLevels.store(std::min(numLevels, kMaxParallelLevels), std::memory_order_relaxed);
+	}
+
+	void Propagate(uint32_t slot) {
+		const TNode& node = mNodeSystem->GetReadAt(mSlotNodeRows[slot]);
+		const uint32_t parentSlot = mSlotParents[slot];
+		const uint32_t rootRow = mSlotRootRows[slot];
+
+		bool recompute = mRecomputeAll || mNodeSystem->GetChunkVersion(mSlotNodeRows[slot] / kChunkRows) > mChangedSince;
+		float px = 0.0f;
+		float py = 0.0f;
+		float pr = 0.0f;
+		if (parentSlot != kNoSlot) {
+			recompute = recompute || mSlotRecomputed[parentSlot] != 0;
+			if (recompute) {
+				const TWorld& parent = mWorldSystem->GetReadAt(mSlotWorldRows[parentSlot]);
+				px = parent.x;
+				py = parent.y;
+				pr = parent.r;
+			}
+		}
+		else if (rootRow != kNoRow) {
+			const TWorld& parent = mWorldSystem->GetReadAt(rootRow);
+			RootParent& seen = mSlotRootParents[slot];
+			if (recompute || parent.x != seen.mX || parent.y != seen.mY || parent.r != seen.mR) {
+				recompute = true;
+				seen.mX = parent.x;
+				seen.mY = parent.y;
+				seen.mR = parent.r;
+			}
+			px = seen.mX;
+			py = seen.mY;
+			pr = seen.mR;
+		}
+		mSlotRecomputed[slot] = recompute ? 1 : 0;
+
+		if (recompute) {
+			const float c = ecs_math::Cos(pr);
+			const float s = ecs_math::Sin(pr);
+			TWorld& world = mWorldSystem->GetWriteAt(mSlotWorldRows[slot], mFrameIndex);
+			world.x = px + c * node.x - s * node.y;
+			world.y = py + s * node.x + c * node.y;
+			world.r = pr + node.r;
+		}
+	}
+
+	ComponentSystem<TNode>*				mNodeSystem;
+	ComponentSystem<TWorld>*			mWorldSystem;
+	bool								mStructureChanged = true;	// nodes must be sorted again
+	bool								mRecomputeAll = false;
+	uint32_t							mFrameIndex = 0;			// frame being propagated
+	uint32_t							mLastFrame = 0;				// frame propagated before it
+	uint32_t							mChangedSince = 0;			// nodes changed after this frame are recomputed
+	std::atomic<uint32_t>				mParallelLevels = 0;
+
+	std::vector<EntityId>				mNodeParents;		// node row -> parent when last sorted
+
+	// depth sorted nodes, level l is the slots [mLevelStart[l], mLevelStart[l + 1])
+	std::vector<uint32_t>				mLevelStart;
+	std::vector<uint32_t>				mSlotNodeRows;
+	std::vector<uint32_t>				mSlotWorldRows;
+	std::vector<uint32_t>				mSlotParents;		// slot of the parent node, kNoSlot at depth 0
+	std::vector<uint32_t>				mSlotRootRows;		// world row of a depth 0 node's parent, kNoRow if none
+	std::vector<RootParent>				mSlotRootParents;
+	std::vector<uint8_t>				mSlotRecomputed;	// this frame, read by the children on the next level
+};
+
+// Places every entity having both TNode and TWorld under its TNode parent. Both components must
+// be registered already.
+template< class TNode, class TWorld >
+void RegisterTransformHierarchy(ComponentManager* mgr) {
+	ComponentSystem<TNode>* nodes = mgr->FindSystem<TNode>();
+	ComponentSystem<TWorld>* world = mgr->FindSystem<TWorld>();
+	assert(nodes != nullptr && world != nullptr);
+	auto* hierarchy = new TransformHierarchy<TNode, TWorld>(nodes, world);
+	nodes->AddQuery(hierarchy);
+	world->AddQuery(hierarchy);
+	mgr->mHierarchies.push_back(hierarchy);
+}
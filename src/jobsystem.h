@@ -62,6 +62,7 @@ namespace jobsystem
     std::mutex                      s_signalLock;       ///< Global mutex for worker signaling.
     std::condition_variable         s_signalThreads;    ///< Global condition var for worker signaling.
     std::atomic<size_t>             s_activeWorkers;
+    thread_local size_t             s_workerIndex = ~size_t(0);  ///< Index of the worker running on this thread, ~0 outside the pool.
 
     inline affinity_t CalculateSafeWorkerAffinity(size_t workerIndex, size_t workerCount)
     {
@@ -115,14 +116,20 @@ namespace jobsystem
         {
             JOBSYSTEM_ASSERT(!IsDone());
 
-            for (const JobStatePtr& dependant : m_dependants)
+            // Seal the dependant list under the same lock TryAddDependant() takes, so a dependant
+            // is either released here or sees the job as already done - never lost in between.
+            std::vector<JobStatePtr> dependants;
             {
-                dependant->m_dependencies.fetch_sub(1, std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(m_doneMutex);
+                dependants.swap(m_dependants);
+                m_done.store(true, std::memory_order_release);
+                m_doneSignal.notify_all();
             }
 
-            std::lock_guard<std::mutex> lock(m_doneMutex);
-            m_done.store(true, std::memory_order_release);
-            m_doneSignal.notify_all();
+            for (const JobStatePtr& dependant : dependants)
+            {
+                dependant->m_dependencies.fetch_sub(1, std::memory_order_acq_rel);
+            }
         }
 
         bool AwaitingCancellation() const
@@ -167,14 +174,34 @@ namespace jobsystem
             return *this;
         }
 
-        JobState& AddDependant(JobStatePtr dependant)
+        /**
+         * Makes dependant wait for this job. Safe to call while this job is queued, running or
+         * already complete, so dependants can be registered against jobs that were readied earlier.
+         * Returns false if this job had already completed, in which case nothing is added.
+         * The dependant itself must not be readied until all of its dependencies are registered.
+         */
+        bool TryAddDependant(JobStatePtr dependant)
         {
+            std::lock_guard<std::mutex> lock(m_doneMutex);
+
+            if (IsDone())
+            {
+                return false;
+            }
+
             JOBSYSTEM_ASSERT(m_dependants.end() == std::find(m_dependants.begin(), m_dependants.end(), dependant));
 
             m_dependants.push_back(dependant);
 
             dependant->m_dependencies.fetch_add(1, std::memory_order_relaxed);
 
+            return true;
+        }
+
+        JobState& AddDependant(JobStatePtr dependant)
+        {
+            TryAddDependant(dependant);
+
             return *this;
         }
 
@@ -221,7 +248,7 @@ namespace jobsystem
                 return false;
             }
 
-            if (m_dependencies.load(std::memory_order_relaxed) > 0)
+            if (m_dependencies.load(std::memory_order_acquire) > 0)
             {
                 return false;
             }
@@ -483,6 +510,7 @@ namespace jobsystem
         void WorkerThreadProc()
         {
             SetThreadName(m_desc.m_name.c_str());
+            s_workerIndex = m_workerIndex;
 
 #if defined(WINDOWS)
             SetThreadAffinityMask(m_thread.native_handle(), m_desc.m_cpuAffinity);
@@ -720,6 +748,21 @@ namespace jobsystem
             return state;
         }
 
+        /**
+         * Slot of the calling thread among GetWorkerSlotCount(): its worker index, or the last
+         * slot for the one thread assisting from outside the pool. Lets jobs pick per-worker
+         * data without locking.
+         */
+        size_t GetWorkerSlot() const
+        {
+            return s_workerIndex < m_workers.size() ? s_workerIndex : m_workers.size();
+        }
+
+        size_t GetWorkerSlotCount() const
+        {
+            return m_workers.size() + 1;
+        }
+
         void AssistUntilJobDone(JobStatePtr state)
         {
             JOBSYSTEM_ASSERT(state->m_ready.load(std::memory_order_acquire));
@@ -7,6 +7,7 @@
 #include <thread>
 
 #include <unordered_map>
+#include <deque>
 
 // jobsystem settings
 #define JOBSYSTEM_ENABLE_PROFILING                ///< Enables worker/job profiling, and an ascii profile dump on shutdown.
@@ -15,14 +16,29 @@
 // jobsystem include
 #include "jobsystem.h"
 
+// scheduler settings
+#ifndef NDEBUG
+#define SCHEDULE_ENABLE_VERIFY                    ///< Checks every frame's task graph orders all conflicting component accesses.
+#endif
+//#define SCHEDULE_ENABLE_LOGGING                 ///< Prints every scheduled task, dependency and job run.
+
+const uint32_t kFramesInFlight = 2;               ///< Frames that may execute concurrently, 1 restores a full barrier per frame.
+
+#include "schedule.h"
+#include "snapshot.h"
+#include "replay.h"
+
+#include <filesystem>
+#include <random>
+#include <bit>
+
 auto hello() -> int;
 auto registerMyComponents(ComponentManager* manager) -> void;
 
-typedef std::unordered_map<std::string, jobsystem::JobStatePtr> JobMap;
-typedef std::vector<jobsystem::JobStatePtr> JobList;
+typedef std::deque<jobsystem::JobStatePtr> JobList;
 
 enum class UpdateStep { PreUpdate, Update, PostUpdate };
-const std::string GetUpdateStepName(UpdateStep step) {
+std::string_view GetUpdateStepName(UpdateStep step) {
 	switch (step) {
 	case UpdateStep::PreUpdate: return "PreUpdate";
 	case UpdateStep::Update: return "Update";
@@ -32,113 +48,320 @@ const std::string GetUpdateStepName(UpdateStep step) {
 	return "";
 }
 
-void runFrameUpdateStep(jobsystem::JobManager& jobManager, EntityManager& entityManager, JobMap& writeMap, JobList& list, const UpdateStep updateStep) {
+// Frames scheduled but not yet retired. With more than one frame in flight the next frame is
+// scheduled without a barrier, so each of its jobs starts as soon as the previous frame's jobs
+// touching the same component fields are done, overlapping one frame's tail with the next's head.
+struct FramePipeline
+{
+	struct Frame
+	{
+		uint32_t					mEndTask;		// one past the frame's last schedule task
+		jobsystem::JobStatePtr		mDone;			// join job, done once every job of the frame is
+		FrameScratch*				mScratch;		// reset once the frame is retired
+	};
+
+	FramePipeline(uint32_t framesInFlight, uint32_t numWorkerSlots)
+	: mFramesInFlight(framesInFlight > 0 ? framesInFlight : 1)
+	, mNumWorkerSlots(numWorkerSlots)
+	{
+		for (uint32_t slot = 0; slot < mFramesInFlight; ++slot) {
+			mScratch.push_back(std::make_unique<FrameScratch>(numWorkerSlots));
+		}
+	}
+
+	// Lets jobs defer structural changes through their ECS_Context. Playback after every update
+	// step is a barrier for all components, so it is only scheduled once enabled.
+	void EnableCommandPlayback() {
+		mCommands.clear();
+		for (uint32_t slot = 0; slot < mFramesInFlight; ++slot) {
+			mCommands.push_back(std::make_unique<EntityCommands>(mNumWorkerSlots));
+		}
+	}
+
+	uint32_t				mFramesInFlight;
+	uint32_t				mNumWorkerSlots;	// workers plus the thread assisting them
+	FrameSchedule			mSchedule;
+	JobList					mJobs;				// job of every schedule task not yet retired
+	std::deque<Frame>		mFrames;
+	WorldRecorder*			mRecorder = nullptr;	// records every frame's diff when set
+	jobsystem::JobStatePtr	mLastDiffWrite;		// diffs are written one frame after another
+	std::vector<std::unique_ptr<EntityCommands>>	mCommands;	// per frame in flight, empty unless enabled
+	std::vector<std::unique_ptr<FrameScratch>>		mScratch;	// per frame in flight
+};
+
+// Adds a job that waits on every earlier job with a conflicting access and readies it
+void scheduleJob(jobsystem::JobManager& jobManager, FramePipeline& pipeline, const std::string& name, const std::vector<ResourceAccess>& accesses, jobsystem::JobDelegate jobFunc, char debugChar) {
+	FrameSchedule& schedule = pipeline.mSchedule;
+	JobList& list = pipeline.mJobs;
+
+	jobsystem::JobStatePtr newJob = jobManager.AddJob(jobFunc, debugChar);
+
+	const uint32_t task = schedule.AddTask(name, accesses);
+	assert(task - schedule.GetFirstTask() == list.size());
+	list.push_back(newJob);
+
+	for (uint32_t dependency : schedule.GetDependencies(task)) {
+		if (dependency < schedule.GetFirstTask()) {
+			continue;	// retired, so already done
+		}
+#ifdef SCHEDULE_ENABLE_LOGGING
+		std::cout << "Dependency " << schedule.GetName(dependency) << "\n";
+#endif
+		// earlier jobs may already be running or done, a finished one needs no edge
+		list[dependency - schedule.GetFirstTask()]->TryAddDependant(newJob);
+	}
+
+	// all dependencies are registered, so the job can start while later steps are scheduled
+	newJob->SetReady();
+}
+
+// Schedules the jobs of one update step, then playback of the structural changes they deferred
+void runFrameUpdateStep(jobsystem::JobManager& jobManager, EntityManager& entityManager, FramePipeline& pipeline, const ECS_Context& frameCtx, const UpdateStep updateStep) {
 	ComponentManager* mgr = entityManager.GetComponentMgr();
+	const uint32_t firstTask = pipeline.mSchedule.GetEndTask();
 
+	// every system is scheduled, empty or not: a playback job of the previous frame may still be
+	// adding or removing rows, so only the jobs themselves can look at how many there are
 	for (IComponentSystem* sys : mgr->mSystems) {
-		const auto& d = sys->GetComponentFunctions();
+		const ComponentFunctionTable& functions = sys->GetComponentFunctions();
 		const std::string componentName = sys->Name();
-		const uint32_t numComponents = sys->NumComponents();
-		if (numComponents == 0) {
-			continue;
-		}
 
-		for (const ComponentTask& fn : d) {
+		for (const ComponentTask& fn : functions.mTasks) {
+#ifdef SCHEDULE_ENABLE_LOGGING
 			std::cout << "Hello " << fn.mName << "\n";
+#endif
 
 			if (fn.mName == GetUpdateStepName(updateStep)) {
 
-				jobsystem::JobDelegate jobFunc = [entityManager, mgr, sys, updateStep] () {
-					int i=0; ++i;
-					const std::string n = sys->Name();
-					if (updateStep == UpdateStep::Update) {
-						std::cout << "Running " << n << " " << GetUpdateStepName(updateStep) << "\n";
-						const ECS_Context& ctx = entityManager.GetContext();
-						sys->FrameUpdate(ctx, mgr);
-					}
+				// each job keeps its frame's context, the next frame may be numbered before it runs
+				const uint32_t taskOrder = pipeline.mSchedule.GetEndTask();
+				jobsystem::JobDelegate jobFunc = [&jobManager, frameCtx, taskOrder, mgr, sys, updateStep] () {
+#ifdef SCHEDULE_ENABLE_LOGGING
+					std::cout << "Running " << sys->Name() << " " << GetUpdateStepName(updateStep) << "\n";
+#endif
+					ECS_Context ctx = frameCtx;
+					ctx.workerSlot = uint32_t(jobManager.GetWorkerSlot());
+					ctx.taskOrder = taskOrder;
+					sys->FrameUpdate(ctx, mgr, GetUpdateStepName(updateStep));
 				};
 
-				jobsystem::JobStatePtr newJob = jobManager.AddJob(jobFunc, componentName[0]);
-				list.push_back(newJob);
-
-				for (const ComponentTask::Dependency& dn : fn.mDepends) {
-					std::cout << "Dependency " << dn.mComponentName << "\n";
-					auto lastWrite = writeMap.find(dn.mComponentName);
-					//bool thisComponent = dn.mComponentName == componentName; dn.mComponentName == '_' when using this
-					bool bDependencyOnLastWrite = false;
-					bool bNewWriteDependency = false;
-					jobsystem::JobStatePtr dependency = nullptr;
-
-					if (dn.mType == ComponentTask::Dependency::Type::This) {
-						bDependencyOnLastWrite = true;
-						lastWrite = writeMap.find(componentName);
-						if (dn.mDir != ComponentTask::Dependency::Direction::in) {
-							// Direction::out || Direction::inout
-							bNewWriteDependency = true;
-						}
-					}
-					else if (dn.mType == ComponentTask::Dependency::Type::MyComponent) {
-						bDependencyOnLastWrite = true;
-						if (dn.mDir != ComponentTask::Dependency::Direction::in) {
-							// Direction::out || Direction::inout
-							bNewWriteDependency = true;
-						}
-					}
-					else if (dn.mType == ComponentTask::Dependency::Type::AllComponents) {
-						bDependencyOnLastWrite = true;
-						if (dn.mDir != ComponentTask::Dependency::Direction::in) {
-							// Direction::out || Direction::inout
-							bNewWriteDependency = true;
-						}
-					}
-
-					if (bDependencyOnLastWrite) {
-						if (lastWrite != writeMap.end()) {
-							dependency = lastWrite->second;
-						}
-					}
-
-					if (dependency != nullptr) {
-						dependency->AddDependant(newJob);
-					}
-
-					if (bNewWriteDependency) {
-						writeMap[dn.mComponentName] = newJob;
-
-						//enum class Direction { unknown, in, out, inout };
-						//enum class Type { Unknown, This, Ctx, MyComponent, AllComponents };
-
-						//Direction		mDir;
-						//Type			mType;
-						//std::string		mComponentName;
-						//std::string		mName;
-					}
-				}
+				scheduleJob(jobManager, pipeline, componentName + "::" + std::string(fn.mName), FrameSchedule::GetAccesses(mgr, sys, fn), jobFunc, componentName[0]);
+			}
+		}
+	}
 
-				//todo: can't launch jobs that may finish before dependency added
-				//newJob->SetReady();
+	EntityCommands* commands = frameCtx.commands;
+	if (commands && pipeline.mSchedule.GetEndTask() > firstTask) {
+		// playback sorts the commands in the scratch memory of the worker running it
+		jobsystem::JobDelegate playbackFunc = [&jobManager, &entityManager, commands, frameCtx]() {
+			ECS_Context ctx = frameCtx;
+			ctx.workerSlot = uint32_t(jobManager.GetWorkerSlot());
+			commands->Playback(entityManager, ctx);
+		};
+		scheduleJob(jobManager, pipeline, std::string(GetUpdateStepName(updateStep)) + "::Playback", FrameSchedule::GetPlaybackAccesses(mgr), playbackFunc, 'p');
+	}
+
+	// events emitted in this step become visible to the later steps' consumers
+	const uint32_t frameIndex = frameCtx.frameIndex;
+	for (IEventChannel* channel : mgr->mEventChannels) {
+		scheduleJob(jobManager, pipeline, channel->Name() + "::PublishEvents", FrameSchedule::GetEventPublishAccesses(mgr, channel), [channel, frameIndex]() { channel->Publish(frameIndex); }, 'e');
+	}
+}
+
+// Waits for the oldest frame in flight, assisting the workers meanwhile, and forgets its tasks
+void retireFrame(jobsystem::JobManager& jobManager, FramePipeline& pipeline) {
+	const FramePipeline::Frame frame = pipeline.mFrames.front();
+	pipeline.mFrames.pop_front();
+
+	jobManager.AssistUntilJobDone(frame.mDone);
+	frame.mScratch->Reset();
+
+	const uint32_t numTasks = frame.mEndTask - pipeline.mSchedule.GetFirstTask();
+	pipeline.mJobs.erase(pipeline.mJobs.begin(), pipeline.mJobs.begin() + numTasks);
+	pipeline.mSchedule.Retire(frame.mEndTask);
+}
+
+void runFrameUpdate(jobsystem::JobManager& jobManager, EntityManager& entityManager, FramePipeline& pipeline) {
+	while (pipeline.mFrames.size() >= pipeline.mFramesInFlight) {
+		retireFrame(jobManager, pipeline);
+	}
+
+	ComponentManager* mgr = entityManager.GetComponentMgr();
+	FrameSchedule& schedule = pipeline.mSchedule;
+	const uint32_t firstTask = schedule.GetEndTask();
+	ECS_Context frameCtx = entityManager.BeginFrame();
+	if (!pipeline.mCommands.empty()) {
+		frameCtx.commands = pipeline.mCommands[frameCtx.frameIndex % pipeline.mCommands.size()].get();
+	}
+	frameCtx.scratch = pipeline.mScratch[frameCtx.frameIndex % pipeline.mScratch.size()].get();
+
+	// bring double buffered components up to date with the frame they publish last
+	const uint32_t frameIndex = frameCtx.frameIndex;
+	for (IComponentSystem* sys : mgr->mSystems) {
+		if (sys->IsDoubleBuffered()) {
+			scheduleJob(jobManager, pipeline, sys->Name() + "::CopyForward", FrameSchedule::GetCopyForwardAccesses(sys), [sys, frameIndex]() { sys->CopyForward(frameIndex); }, 'c');
+		}
+	}
+
+	// rebuild spatial indices from the positions this frame's readers see, gathering in slices
+	for (ISpatialIndex* index : mgr->mSpatialIndices) {
+		const std::string componentName = index->GetSystem()->Name();
+		scheduleJob(jobManager, pipeline, componentName + "::SpatialPrepare", FrameSchedule::GetSpatialPrepareAccesses(index), [index, frameIndex]() { index->Prepare(frameIndex); }, 'i');
+		for (uint32_t slice = 0; slice < ISpatialIndex::kNumSlices; ++slice) {
+			scheduleJob(jobManager, pipeline, componentName + "::SpatialGather", FrameSchedule::GetSpatialGatherAccesses(index, slice), [index, slice]() { index->Gather(slice); }, 'i');
+		}
+		scheduleJob(jobManager, pipeline, componentName + "::SpatialBuild", FrameSchedule::GetSpatialBuildAccesses(index), [index]() { index->Build(); }, 'i');
+	}
+
+	runFrameUpdateStep(jobManager, entityManager, pipeline, frameCtx, UpdateStep::PreUpdate);
+	runFrameUpdateStep(jobManager, entityManager, pipeline, frameCtx, UpdateStep::Update);
+	runFrameUpdateStep(jobManager, entityManager, pipeline, frameCtx, UpdateStep::PostUpdate);
+
+	// place children under their parents' final transforms, one parallel-for per level down to the
+	// depth found last frame and everything deeper in one job
+	for (ITransformHierarchy* hierarchy : mgr->mHierarchies) {
+		const std::string componentName = hierarchy->GetNodeSystem()->Name();
+		const uint32_t parallelLevels = hierarchy->GetParallelLevels();
+		scheduleJob(jobManager, pipeline, componentName + "::HierarchyBegin", FrameSchedule::GetHierarchyBeginAccesses(hierarchy), [hierarchy, frameIndex]() { hierarchy->Begin(frameIndex); }, 'h');
+		for (uint32_t level = 0; level < parallelLevels; ++level) {
+			for (uint32_t slice = 0; slice < ITransformHierarchy::kNumSlices; ++slice) {
+				scheduleJob(jobManager, pipeline, componentName + "::HierarchyLevel", FrameSchedule::GetHierarchyLevelAccesses(hierarchy, level, slice), [hierarchy, level, slice]() { hierarchy->PropagateLevel(level, slice); }, 'h');
 			}
 		}
+		scheduleJob(jobManager, pipeline, componentName + "::HierarchyDeep", FrameSchedule::GetHierarchyLevelAccesses(hierarchy, parallelLevels, 0), [hierarchy, parallelLevels]() { hierarchy->PropagateFrom(parallelLevels); }, 'h');
+		scheduleJob(jobManager, pipeline, componentName + "::HierarchyEnd", FrameSchedule::GetHierarchyEndAccesses(hierarchy, parallelLevels), []() {}, 'h');
+	}
+
+	// encode what the frame changed before SwapBuffers publishes it
+	WorldRecorder* recorder = pipeline.mRecorder;
+	std::shared_ptr<RecordedFrame> recorded;
+	if (recorder) {
+		recorded = recorder->BeginFrame(frameCtx.frameIndex);
+		scheduleJob(jobManager, pipeline, "Entities::Record", FrameSchedule::GetEntityRecordAccesses(), [recorder, recorded, &entityManager]() { recorder->RecordEntities(*recorded, entityManager); }, 'r');
+		for (size_t i = 0; i < mgr->mSystems.size(); ++i) {
+			IComponentSystem* sys = mgr->mSystems[i];
+			scheduleJob(jobManager, pipeline, sys->Name() + "::Record", FrameSchedule::GetRecordAccesses(sys), [recorder, recorded, i]() { recorder->RecordSystem(*recorded, i); }, 'r');
+		}
+	}
+
+	// publish this frame's writes to next frame's readers
+	for (IComponentSystem* sys : mgr->mSystems) {
+		if (sys->IsDoubleBuffered()) {
+			scheduleJob(jobManager, pipeline, sys->Name() + "::SwapBuffers", FrameSchedule::GetSwapAccesses(sys), [sys]() { sys->SwapBuffers(); }, 's');
+		}
 	}
+
+#ifdef SCHEDULE_ENABLE_VERIFY
+	std::string scheduleError;
+	if (!schedule.Verify(scheduleError)) {
+		std::cout << "Invalid frame schedule: " << scheduleError << "\n";
+		assert(false);
+	}
+#endif
+
+	FramePipeline::Frame frame;
+	frame.mEndTask = schedule.GetEndTask();
+	frame.mScratch = frameCtx.scratch;
+	frame.mDone = jobManager.AddJob([]() {}, 'J');
+	for (uint32_t task = firstTask; task < frame.mEndTask; ++task) {
+		pipeline.mJobs[task - schedule.GetFirstTask()]->TryAddDependant(frame.mDone);
+	}
+	frame.mDone->SetReady();
+
+	// stream the diff to disk in the background, behind the frame and the previous diff
+	if (recorded) {
+		jobsystem::JobStatePtr write = jobManager.AddJob([recorder, recorded]() { recorder->WriteFrame(*recorded); }, 'w');
+		frame.mDone->TryAddDependant(write);
+		if (pipeline.mLastDiffWrite) {
+			pipeline.mLastDiffWrite->TryAddDependant(write);
+		}
+		write->SetReady();
+		pipeline.mLastDiffWrite = write;
+	}
+
+	pipeline.mFrames.push_back(frame);
 }
 
-void runFrameUpdate(jobsystem::JobManager& jobManager, EntityManager& entityManager) {
-	JobMap writeMap;
-	JobList jobList;
+// Waits for every frame still in flight
+void flushFrames(jobsystem::JobManager& jobManager, FramePipeline& pipeline) {
+	while (!pipeline.mFrames.empty()) {
+		retireFrame(jobManager, pipeline);
+	}
+	if (pipeline.mLastDiffWrite) {
+		jobManager.AssistUntilJobDone(pipeline.mLastDiffWrite);
+		pipeline.mLastDiffWrite = nullptr;
+	}
+}
 
-	runFrameUpdateStep(jobManager, entityManager, writeMap, jobList, UpdateStep::PreUpdate);
-	runFrameUpdateStep(jobManager, entityManager, writeMap, jobList, UpdateStep::Update);
-	runFrameUpdateStep(jobManager, entityManager, writeMap, jobList, UpdateStep::PostUpdate);
+std::string_view GetSimdLevelName(ecs_math::SimdLevel level) {
+	switch (level) {
+	case ecs_math::SimdLevel::Scalar: return "scalar";
+	case ecs_math::SimdLevel::SSE2: return "SSE2";
+	case ecs_math::SimdLevel::AVX2: return "AVX2";
+	default: return "";
+	};
+	return "";
+}
 
-	for(auto& t : jobList) {
-		t->SetReady();
+// Runs the ECS_Math batch kernels at every code path the CPU supports and compares them bit for
+// bit with the scalar functions the systems call, on an odd count so the scalar tails run too
+bool checkMathKernels(std::string& error) {
+	const size_t count = 1027;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> angle(-10000.0f, 10000.0f);
+	std::uniform_real_distribution<float> coord(-1000.0f, 1000.0f);
+	std::vector<float> r(count), ax(count), ay(count), bx(count), by(count);
+	for (size_t i = 0; i < count; ++i) {
+		r[i] = (i < 8) ? float(i) * ecs_math::kHalfPi * 0.5f - ecs_math::kPi : angle(rng);
+		ax[i] = coord(rng);
+		ay[i] = coord(rng);
+		bx[i] = (i % 16 == 0) ? ax[i] : coord(rng);	// straight up or down, or no heading at all
+		by[i] = (i % 32 == 0) ? ay[i] : coord(rng);
 	}
 
-	jobManager.AssistUntilDone();
-	//Wait till all finished
-	//for (auto& t : jobList) {
-	//	t->Wait();
-	//}	
+	ECS_Math math;
+	const ecs_math::SimdLevel detected = math.getSimdLevel();
+	std::vector<float> out(count);
+	for (ecs_math::SimdLevel level : { ecs_math::SimdLevel::Scalar, ecs_math::SimdLevel::SSE2, ecs_math::SimdLevel::AVX2 }) {
+		if (level > detected) {
+			break;
+		}
+		math.setSimdLevel(level);
+		auto compare = [&](const char* kernel, auto scalar) {
+			for (size_t i = 0; i < count; ++i) {
+				if (std::bit_cast<uint32_t>(out[i]) != std::bit_cast<uint32_t>(scalar(i))) {
+					error = std::string(kernel) + " at " + std::string(GetSimdLevelName(level)) + " differs from scalar at element " + std::to_string(i);
+					return false;
+				}
+			}
+			return true;
+		};
+
+		math.lookAtN(ax, ay, bx, by, out);
+		if (!compare("lookAtN", [&](size_t i) { return math.lookAt(ax[i], ay[i], bx[i], by[i]); })) {
+			return false;
+		}
+		math.forwardN(r, out);
+		if (!compare("forwardN", [&](size_t i) { return math.forward(r[i]); })) {
+			return false;
+		}
+		math.sinN(r, out);
+		if (!compare("sinN", [&](size_t i) { return math.sin(r[i]); })) {
+			return false;
+		}
+		math.atan2N(ay, ax, out);
+		if (!compare("atan2N", [&](size_t i) { return math.atan2(ay[i], ax[i]); })) {
+			return false;
+		}
+
+		// in place, out aliasing the input
+		out = r;
+		math.cosN(out, out);
+		if (!compare("cosN in place", [&](size_t i) { return math.cos(r[i]); })) {
+			return false;
+		}
+	}
+	return true;
 }
 
 int main()
@@ -167,6 +390,9 @@ int main()
 	std::unique_ptr < EntityManager > entityManager = std::make_unique<EntityManager>();
     ComponentManager* mgr = entityManager->GetComponentMgr();
     registerMyComponents(mgr);
+	for (IEventChannel* channel : mgr->mEventChannels) {
+		channel->SetWorkerSlotCount(uint32_t(jobManager->GetWorkerSlotCount()));
+	}
 
 	hello();
 
@@ -174,10 +400,19 @@ int main()
 	IComponentSystem* pPlayerDataSystem = mgr->GetSystemByName("PlayerData");
 	IComponentSystem* pMoveForwardSystem = mgr->GetSystemByName("MoveForward");
 	IComponentSystem* pFacePlayerSystem = mgr->GetSystemByName("FacePlayer");
+	IComponentSystem* pHealthSystem = mgr->GetSystemByName("Health");
+	IComponentSystem* pCombatSystem = mgr->GetSystemByName("Combat");
+	IComponentSystem* pCameraSystem = mgr->GetSystemByName("Camera");
 	//IComponentSystem* pNameSystem = mgr->GetSystemByName("Name");
 	//IComponentSystem* pMyComponentSystem = mgr->GetSystemByName("MyComponent");
 
 #if 1
+	// resolves the damage tanks deal to players
+	pCombatSystem->Alloc(entityManager->AllocEntity());
+
+	// follows the players
+	pCameraSystem->Alloc(entityManager->AllocEntity());
+
 	std::vector<EntityId> players;
 	const int numPlayers = 100;
 	for(int iPlayer=0; iPlayer< numPlayers; ++iPlayer) {
@@ -185,6 +420,7 @@ int main()
 		EntityId player = entityManager->AllocEntity();
 		pTransformSystem->Alloc(player);
 		pPlayerDataSystem->Alloc(player);
+		pHealthSystem->Alloc(player);
 		players.push_back(player);
 
 		// Create 100 tanks entities per player that move towards player
@@ -194,13 +430,109 @@ int main()
 			pTransformSystem->Alloc(tank);
 			pMoveForwardSystem->Alloc(tank);
 			pFacePlayerSystem->Alloc(tank);
+
+			// with a turret riding on it
+			EntityId turret = entityManager->AllocEntity();
+			pTransformSystem->Alloc(turret);
+			mgr->mHierarchies.front()->Attach(turret, tank);
 		}
 	}
 #endif
 
 	//const auto& d = pFacePlayerSystem->GetComponentFunctions();
 	hello();
-	runFrameUpdate(*jobManager, *entityManager);
+
+	// The systems call the scalar math, batch callers must get the same headings
+	{
+		std::string mathError;
+		if (checkMathKernels(mathError)) {
+			std::cout << "math batch kernels match scalar up to " << GetSimdLevelName(ECS_Math().getSimdLevel()) << "\n";
+		}
+		else {
+			std::cout << "Math kernels failed: " << mathError << "\n";
+		}
+	}
+
+	// Compare a full barrier per frame against pipelined frames on the tank scene
+	const int numFrames = 200;
+	const uint32_t frameDepths[] = { 1, kFramesInFlight };
+	for (uint32_t framesInFlight : frameDepths) {
+		FramePipeline pipeline(framesInFlight, uint32_t(jobManager->GetWorkerSlotCount()));
+		pipeline.EnableCommandPlayback();	// players out of health respawn
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int iFrame = 0; iFrame < numFrames; ++iFrame) {
+			runFrameUpdate(*jobManager, *entityManager, pipeline);
+		}
+		flushFrames(*jobManager, pipeline);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		std::cout << numFrames << " frames, " << framesInFlight << " in flight: " << ms << " ms (" << (numFrames * 1000.0 / ms) << " frames/s)\n";
+	}
+
+	// Round trip the world through a snapshot, frames are flushed so nothing is in flight
+	{
+		const std::string snapshotPath = (std::filesystem::temp_directory_path() / "ecs-world.snapshot").string();
+		std::string snapshotError;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		const bool saved = SaveWorldSnapshot(*entityManager, snapshotPath, snapshotError);
+		auto saveEnd = std::chrono::high_resolution_clock::now();
+		const bool loaded = saved && LoadWorldSnapshot(*entityManager, snapshotPath, snapshotError);
+		auto loadEnd = std::chrono::high_resolution_clock::now();
+
+		if (!loaded) {
+			std::cout << "Snapshot failed: " << snapshotError << "\n";
+		}
+		else {
+			std::cout << "snapshot of " << entityManager->GetEntities().size() << " entities: save " << std::chrono::duration<double, std::milli>(saveEnd - start).count()
+				<< " ms, load " << std::chrono::duration<double, std::milli>(loadEnd - saveEnd).count() << " ms\n";
+		}
+		std::filesystem::remove(snapshotPath);
+	}
+
+	// Record pipelined frames as diffs, then rebuild the last one from the base snapshot
+	{
+		const std::filesystem::path tempDir = std::filesystem::temp_directory_path();
+		const std::string basePath = (tempDir / "ecs-replay-base.snapshot").string();
+		const std::string diffPath = (tempDir / "ecs-replay.diff").string();
+		std::string replayError;
+
+		WorldRecorder recorder;
+		if (!recorder.Begin(*entityManager, basePath, diffPath, replayError)) {
+			std::cout << "Recording failed: " << replayError << "\n";
+		}
+		else {
+			FramePipeline pipeline(kFramesInFlight, uint32_t(jobManager->GetWorkerSlotCount()));
+			pipeline.EnableCommandPlayback();
+			pipeline.mRecorder = &recorder;
+			for (int iFrame = 0; iFrame < numFrames; ++iFrame) {
+				runFrameUpdate(*jobManager, *entityManager, pipeline);
+			}
+			flushFrames(*jobManager, pipeline);
+			recorder.End();
+
+			// every column as it is live, to compare the replayed frame against
+			std::vector<std::vector<char>> liveColumns;
+			for (IComponentSystem* sys : mgr->mSystems) {
+				const char* rows = static_cast<const char*>(sys->GetRowBytes(false));
+				liveColumns.emplace_back(rows, rows + (rows ? size_t(sys->NumComponents()) * sys->GetComponentSize() : 0));
+			}
+			const uint32_t lastFrame = entityManager->GetContext().frameIndex;
+
+			WorldReplay replay;
+			bool matches = replay.Open(basePath, diffPath, replayError) && replay.Seek(*entityManager, lastFrame, replayError);
+			for (size_t i = 0; matches && i < mgr->mSystems.size(); ++i) {
+				const char* rows = static_cast<const char*>(mgr->mSystems[i]->GetRowBytes(false));
+				matches = (liveColumns[i].empty() || memcmp(rows, liveColumns[i].data(), liveColumns[i].size()) == 0);
+			}
+			std::cout << "recorded " << numFrames << " frames in " << recorder.GetBytesWritten() << " bytes of diffs, replay of frame " << lastFrame
+				<< (matches ? " matches" : " differs") << (replayError.empty() ? "" : ": " + replayError) << "\n";
+		}
+		std::filesystem::remove(basePath);
+		std::filesystem::remove(diffPath);
+	}
 
 	//// Run entity system for 100 frames
 	//for (int i = 0; i < 100; ++i) {
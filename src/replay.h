@@ -0,0 +1,468 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <span>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#include "component.h"
+#include "snapshot.h"
+
+// Frame diff stream: starts from a world snapshot and records, for every following frame, only
+// the chunks of each component system that changed (see ComponentSystem change detection).
+// A chunk's entity column and, for trivially copyable components, its rows are XORed with the
+// same chunk as it was last recorded, and the result is run-length encoded, so bytes that didn't
+// change cost nothing and memory and disk grow with what changed, not with the world.
+//
+//   DiffStreamHeader
+//   per recorded frame:
+//     DiffFrameHeader
+//     EntityId[mNumNewEntities]                 allocated since the previous frame
+//     uint32_t[mNumFreedEntities]               indices of entities freed since then
+//     per system with changes:
+//       DiffSystemHeader
+//       per changed chunk: uint32_t chunk, entity column delta, row column delta
+//
+// A delta is a uint32_t byte count followed by (skip, literal) pairs: a varint count of bytes
+// equal to the previous recording, a varint count of bytes that differ, then those XORed bytes.
+// Bytes past the last pair are unchanged.
+
+constexpr uint32_t kDiffStreamMagic = 0x46444345;		// "ECDF"
+constexpr uint32_t kDiffStreamVersion = 2;
+
+struct DiffStreamHeader
+{
+	uint32_t	mMagic;
+	uint32_t	mVersion;
+	uint32_t	mBaseFrameIndex;		// frame of the snapshot the first diff applies to
+	uint32_t	mPad;
+};
+
+struct DiffFrameHeader
+{
+	uint32_t	mFrameIndex;
+	uint32_t	mNumEntities;
+	uint32_t	mNumNewEntities;
+	uint32_t	mNumFreedEntities;
+	uint32_t	mNumSystems;			// systems with changes
+	uint32_t	mPad;
+	uint64_t	mSize;					// bytes following this header
+};
+
+struct DiffSystemHeader
+{
+	ComponentTypeId		mTypeId;
+	uint32_t			mNumRows;
+	uint32_t			mNumChunks;
+};
+
+inline void AppendVarint(std::vector<char>& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back(char(uint8_t(value) | 0x80));
+		value >>= 7;
+	}
+	out.push_back(char(value));
+}
+
+inline bool ReadVarint(const char*& in, const char* end, uint64_t& value) {
+	value = 0;
+	for (uint32_t shift = 0; in < end && shift < 64; shift += 7) {
+		const uint8_t byte = uint8_t(*in++);
+		value |= uint64_t(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template< class T >
+void AppendValue(std::vector<char>& out, const T& value) {
+	const char* bytes = reinterpret_cast<const char*>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template< class T >
+bool ReadValue(const char*& in, const char* end, T& value) {
+	if (size_t(end - in) < sizeof(T)) {
+		return false;
+	}
+	memcpy(&value, in, sizeof(T));
+	in += sizeof(T);
+	return true;
+}
+
+// Appends the delta from recorded to bytes and updates recorded to match
+inline void AppendXorDelta(std::vector<char>& out, const char* bytes, char* recorded, size_t size) {
+	// runs of fewer equal bytes stay inside a literal, a new pair would cost more than they save
+	constexpr size_t kMinSkip = 3;
+
+	const size_t sizeAt = out.size();
+	AppendValue(out, uint32_t(0));
+	size_t pos = 0;
+	while (pos < size) {
+		size_t literal = pos;
+		while (literal < size && bytes[literal] == recorded[literal]) {
+			++literal;
+		}
+		if (literal == size) {
+			break;
+		}
+		size_t skip = literal;
+		size_t equal = 0;
+		while (skip < size && equal < kMinSkip) {
+			equal = (bytes[skip] == recorded[skip]) ? equal + 1 : 0;
+			++skip;
+		}
+		skip -= equal;
+
+		AppendVarint(out, literal - pos);
+		AppendVarint(out, skip - literal);
+		for (size_t i = literal; i < skip; ++i) {
+			out.push_back(char(bytes[i] ^ recorded[i]));
+		}
+		pos = skip;
+	}
+	if (size > 0) {
+		memcpy(recorded, bytes, size);
+	}
+
+	const uint32_t deltaSize = uint32_t(out.size() - sizeAt - sizeof(uint32_t));
+	memcpy(out.data() + sizeAt, &deltaSize, sizeof(deltaSize));
+}
+
+// Applies a delta written by AppendXorDelta to bytes, false when it doesn't fit
+inline bool ApplyXorDelta(const char*& in, const char* end, char* bytes, size_t size) {
+	uint32_t deltaSize;
+	if (!ReadValue(in, end, deltaSize) || deltaSize > size_t(end - in)) {
+		return false;
+	}
+	const char* deltaEnd = in + deltaSize;
+	size_t pos = 0;
+	while (in < deltaEnd) {
+		uint64_t skip, literal;
+		if (!ReadVarint(in, deltaEnd, skip) || !ReadVarint(in, deltaEnd, literal)
+			|| skip > size - pos || literal > size - pos - skip || literal > size_t(deltaEnd - in)) {
+			return false;
+		}
+		pos += skip;
+		for (uint64_t i = 0; i < literal; ++i) {
+			bytes[pos++] ^= *in++;
+		}
+	}
+	return true;
+}
+
+// One frame's diff, encoded by the record jobs and written by a background job
+struct RecordedFrame
+{
+	uint32_t						mFrameIndex;
+	uint32_t						mNumEntities;
+	std::vector<EntityId>			mNewEntities;
+	std::vector<uint32_t>			mFreedEntities;
+	std::vector<std::vector<char>>	mSystems;		// DiffSystemHeader and chunk deltas, empty when unchanged
+};
+
+// Records frame diffs of a world. For every frame the caller schedules RecordEntities as a job
+// with FrameSchedule::GetEntityRecordAccesses, RecordSystem for every system as a job with
+// FrameSchedule::GetRecordAccesses, and WriteFrame as a job after the frame and the previous
+// WriteFrame, so encoding and disk writes stay off the main thread.
+class WorldRecorder
+{
+public:
+	// Saves the base snapshot and starts the diff stream at the world as it is now. Must not
+	// run while frames are in flight.
+	bool Begin(EntityManager& entityManager, const std::string& snapshotPath, const std::string& diffPath, std::string& error) {
+		if (!SaveWorldSnapshot(entityManager, snapshotPath, error)) {
+			return false;
+		}
+		mOut.open(diffPath, std::ios::binary | std::ios::trunc);
+		if (!mOut) {
+			error = "cannot open " + diffPath + " for writing";
+			return false;
+		}
+
+		const uint32_t baseFrame = entityManager.GetContext().frameIndex;
+		DiffStreamHeader header = {};
+		header.mMagic = kDiffStreamMagic;
+		header.mVersion = kDiffStreamVersion;
+		header.mBaseFrameIndex = baseFrame;
+		mOut.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		mBytesWritten = sizeof(header);
+
+		// the recorded copy of every column starts out as the snapshot
+		mNumEntities = uint32_t(entityManager.GetEntities().size());
+		mNumFreed = uint32_t(entityManager.GetFreedEntities().size());
+		mSystems.clear();
+		for (IComponentSystem* sys : entityManager.GetComponentMgr()->mSystems) {
+			SystemState state;
+			state.mSystem = sys;
+			state.mRecordedFrame = baseFrame;
+			const std::span<const EntityId> entities = sys->GetEntities();
+			state.mEntities.assign(reinterpret_cast<const char*>(entities.data()), reinterpret_cast<const char*>(entities.data() + entities.size()));
+			if (const char* rows = static_cast<const char*>(sys->GetRowBytes(false))) {
+				state.mRows.assign(rows, rows + size_t(sys->NumComponents()) * sys->GetComponentSize());
+			}
+			mSystems.push_back(std::move(state));
+		}
+		return true;
+	}
+
+	// Called on the main thread when a frame is scheduled
+	std::shared_ptr<RecordedFrame> BeginFrame(uint32_t frameIndex) {
+		auto frame = std::make_shared<RecordedFrame>();
+		frame->mFrameIndex = frameIndex;
+		frame->mSystems.resize(mSystems.size());
+		return frame;
+	}
+
+	// Captures the entities allocated and freed since the previous frame
+	void RecordEntities(RecordedFrame& frame, const EntityManager& entityManager) {
+		const std::span<const EntityId> entities = entityManager.GetEntities();
+		frame.mNumEntities = uint32_t(entities.size());
+		frame.mNewEntities.assign(entities.begin() + std::min<size_t>(mNumEntities, entities.size()), entities.end());
+		mNumEntities = frame.mNumEntities;
+
+		const std::span<const uint32_t> freed = entityManager.GetFreedEntities();
+		frame.mFreedEntities.assign(freed.begin() + std::min<size_t>(mNumFreed, freed.size()), freed.end());
+		mNumFreed = uint32_t(freed.size());
+	}
+
+	// Encodes the chunks of one system changed since its last recording
+	void RecordSystem(RecordedFrame& frame, size_t systemIndex) {
+		SystemState& state = mSystems[systemIndex];
+		IComponentSystem* sys = state.mSystem;
+		const uint32_t numRows = sys->NumComponents();
+		const size_t rowSize = sys->IsTriviallyCopyable() ? sys->GetComponentSize() : 0;
+		const uint32_t sinceFrame = state.mRecordedFrame;
+		state.mRecordedFrame = frame.mFrameIndex;
+
+		// rows freed at the end are dropped, new rows are diffed against zeros
+		const bool resized = (state.mEntities.size() != numRows * sizeof(EntityId));
+		state.mEntities.resize(numRows * sizeof(EntityId));
+		state.mRows.resize(numRows * rowSize);
+
+		std::vector<char>& out = frame.mSystems[systemIndex];
+		DiffSystemHeader header = {};
+		header.mTypeId = sys->GetTypeId();
+		header.mNumRows = numRows;
+		AppendValue(out, header);
+
+		const char* entities = reinterpret_cast<const char*>(sys->GetEntities().data());
+		const char* rows = static_cast<const char*>(sys->GetRowBytes(false));
+		for (uint32_t chunk = 0; chunk < sys->NumChunks(); ++chunk) {
+			if (!sys->IsChunkChangedSince(chunk, sinceFrame)) {
+				continue;
+			}
+			const size_t begin = size_t(chunk) * IComponentSystem::kChunkRows;
+			const size_t end = std::min<size_t>(begin + IComponentSystem::kChunkRows, numRows);
+			AppendValue(out, chunk);
+			AppendXorDelta(out, entities + begin * sizeof(EntityId), state.mEntities.data() + begin * sizeof(EntityId), (end - begin) * sizeof(EntityId));
+			AppendXorDelta(out, rows + begin * rowSize, state.mRows.data() + begin * rowSize, (end - begin) * rowSize);
+			++header.mNumChunks;
+		}
+
+		if (header.mNumChunks == 0 && !resized) {
+			out.clear();
+		}
+		else {
+			memcpy(out.data(), &header, sizeof(header));
+		}
+	}
+
+	// Appends an encoded frame to the stream, frames must be written in order
+	void WriteFrame(const RecordedFrame& frame) {
+		DiffFrameHeader header = {};
+		header.mFrameIndex = frame.mFrameIndex;
+		header.mNumEntities = frame.mNumEntities;
+		header.mNumNewEntities = uint32_t(frame.mNewEntities.size());
+		header.mNumFreedEntities = uint32_t(frame.mFreedEntities.size());
+		header.mSize = frame.mNewEntities.size() * sizeof(EntityId) + frame.mFreedEntities.size() * sizeof(uint32_t);
+		for (const std::vector<char>& system : frame.mSystems) {
+			header.mNumSystems += system.empty() ? 0 : 1;
+			header.mSize += system.size();
+		}
+		// pad so the next frame's header is aligned for the reader's mapping
+		const size_t padding = size_t(-header.mSize) % alignof(DiffFrameHeader);
+		header.mSize += padding;
+
+		mOut.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		mOut.write(reinterpret_cast<const char*>(frame.mNewEntities.data()), std::streamsize(frame.mNewEntities.size() * sizeof(EntityId)));
+		mOut.write(reinterpret_cast<const char*>(frame.mFreedEntities.data()), std::streamsize(frame.mFreedEntities.size() * sizeof(uint32_t)));
+		for (const std::vector<char>& system : frame.mSystems) {
+			mOut.write(system.data(), std::streamsize(system.size()));
+		}
+		const char zeros[alignof(DiffFrameHeader)] = {};
+		mOut.write(zeros, std::streamsize(padding));
+		mBytesWritten += sizeof(header) + header.mSize;
+	}
+
+	// Flushes the stream, once the last WriteFrame is done
+	bool End() {
+		mOut.close();
+		return !mOut.fail();
+	}
+
+	uint64_t GetBytesWritten() const {
+		return mBytesWritten;
+	}
+
+private:
+	struct SystemState
+	{
+		IComponentSystem*		mSystem;
+		uint32_t				mRecordedFrame;		// frame the columns below were recorded at
+		std::vector<char>		mEntities;
+		std::vector<char>		mRows;				// empty unless trivially copyable
+	};
+
+	std::vector<SystemState>	mSystems;			// in registration order
+	uint32_t					mNumEntities = 0;
+	uint32_t					mNumFreed = 0;
+	std::ofstream				mOut;
+	uint64_t					mBytesWritten = 0;
+};
+
+// Rebuilds any recorded frame of a world from its base snapshot and diff stream
+class WorldReplay
+{
+public:
+	bool Open(const std::string& snapshotPath, const std::string& diffPath, std::string& error) {
+		mSnapshotPath = snapshotPath;
+		mFrames.clear();
+		if (!mDiffs.Open(diffPath)) {
+			error = "cannot map " + diffPath;
+			return false;
+		}
+		const DiffStreamHeader* header = mDiffs.At<DiffStreamHeader>(0, 1);
+		if (header == nullptr || header->mMagic != kDiffStreamMagic || header->mVersion != kDiffStreamVersion) {
+			error = diffPath + " is not a diff stream of this version";
+			return false;
+		}
+		mBaseFrameIndex = header->mBaseFrameIndex;
+
+		// index the frames, a partly written last frame is ignored
+		uint64_t offset = sizeof(DiffStreamHeader);
+		while (const DiffFrameHeader* frame = mDiffs.At<DiffFrameHeader>(offset, 1)) {
+			if (frame->mSize > mDiffs.Size() - offset - sizeof(DiffFrameHeader)) {
+				break;
+			}
+			mFrames.push_back(offset);
+			offset += sizeof(DiffFrameHeader) + frame->mSize;
+		}
+		return true;
+	}
+
+	uint32_t GetBaseFrame() const {
+		return mBaseFrameIndex;
+	}
+
+	uint32_t GetLastFrame() const {
+		return mFrames.empty() ? mBaseFrameIndex : mDiffs.At<DiffFrameHeader>(mFrames.back(), 1)->mFrameIndex;
+	}
+
+	// Replaces the world with its state at the end of frameIndex: loads the base snapshot and
+	// applies every diff up to that frame. Must not run while frames are in flight.
+	bool Seek(EntityManager& entityManager, uint32_t frameIndex, std::string& error) {
+		if (frameIndex < mBaseFrameIndex || frameIndex > GetLastFrame()) {
+			error = "frame " + std::to_string(frameIndex) + " was not recorded";
+			return false;
+		}
+		if (!LoadWorldSnapshot(entityManager, mSnapshotPath, error)) {
+			return false;
+		}
+
+		std::vector<IComponentSystem*>& systems = entityManager.GetComponentMgr()->mSystems;
+		std::vector<EntityId> entities(entityManager.GetEntities().begin(), entityManager.GetEntities().end());
+		std::vector<std::vector<EntityId>> systemEntities;
+		std::vector<std::vector<char>> systemRows;
+		for (IComponentSystem* sys : systems) {
+			systemEntities.emplace_back(sys->GetEntities().begin(), sys->GetEntities().end());
+			const char* rows = static_cast<const char*>(sys->GetRowBytes(false));
+			systemRows.emplace_back(rows, rows + (rows ? size_t(sys->NumComponents()) * sys->GetComponentSize() : 0));
+		}
+
+		for (uint64_t frameOffset : mFrames) {
+			const DiffFrameHeader* frame = mDiffs.At<DiffFrameHeader>(frameOffset, 1);
+			if (frame->mFrameIndex > frameIndex) {
+				break;
+			}
+			const char* in = mDiffs.At<char>(frameOffset + sizeof(DiffFrameHeader), frame->mSize);
+			const char* end = in + frame->mSize;
+
+			if (uint64_t(frame->mNumNewEntities) * sizeof(EntityId) + uint64_t(frame->mNumFreedEntities) * sizeof(uint32_t) > frame->mSize) {
+				error = "corrupt diff of frame " + std::to_string(frame->mFrameIndex);
+				return false;
+			}
+			const EntityId* newEntities = reinterpret_cast<const EntityId*>(in);
+			entities.insert(entities.end(), newEntities, newEntities + frame->mNumNewEntities);
+			in += frame->mNumNewEntities * sizeof(EntityId);
+			for (uint32_t i = 0; i < frame->mNumFreedEntities; ++i) {
+				uint32_t index;
+				if (!ReadValue(in, end, index)) {
+					error = "corrupt diff of frame " + std::to_string(frame->mFrameIndex);
+					return false;
+				}
+				if (index < entities.size()) {
+					entities[index] = EntityId();
+				}
+			}
+
+			for (uint32_t i = 0; i < frame->mNumSystems; ++i) {
+				DiffSystemHeader header;
+				if (!ReadValue(in, end, header) || !ApplySystem(systems, systemEntities, systemRows, header, in, end)) {
+					error = "corrupt diff of frame " + std::to_string(frame->mFrameIndex);
+					return false;
+				}
+			}
+		}
+
+		entityManager.AdoptEntities(entities, frameIndex);
+		for (size_t i = 0; i < systems.size(); ++i) {
+			const char* rows = systems[i]->IsTriviallyCopyable() ? systemRows[i].data() : nullptr;
+			systems[i]->Adopt(systemEntities[i], rows, rows);
+		}
+		return true;
+	}
+
+private:
+	static bool ApplySystem(std::vector<IComponentSystem*>& systems, std::vector<std::vector<EntityId>>& systemEntities, std::vector<std::vector<char>>& systemRows,
+		const DiffSystemHeader& header, const char*& in, const char* end) {
+		size_t index = 0;
+		while (index < systems.size() && systems[index]->GetTypeId() != header.mTypeId) {
+			++index;
+		}
+		if (index == systems.size()) {
+			return false;
+		}
+		IComponentSystem* sys = systems[index];
+		const size_t rowSize = sys->IsTriviallyCopyable() ? sys->GetComponentSize() : 0;
+		std::vector<EntityId>& entities = systemEntities[index];
+		std::vector<char>& rows = systemRows[index];
+		entities.resize(header.mNumRows);
+		rows.resize(header.mNumRows * rowSize);
+
+		for (uint32_t i = 0; i < header.mNumChunks; ++i) {
+			uint32_t chunk;
+			if (!ReadValue(in, end, chunk) || size_t(chunk) * IComponentSystem::kChunkRows >= header.mNumRows) {
+				return false;
+			}
+			const size_t begin = size_t(chunk) * IComponentSystem::kChunkRows;
+			const size_t numRows = std::min<size_t>(IComponentSystem::kChunkRows, header.mNumRows - begin);
+			if (!ApplyXorDelta(in, end, reinterpret_cast<char*>(entities.data() + begin), numRows * sizeof(EntityId))
+				|| !ApplyXorDelta(in, end, rows.data() + begin * rowSize, numRows * rowSize)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::string				mSnapshotPath;
+	SnapshotFile			mDiffs;
+	uint32_t				mBaseFrameIndex = 0;
+	std::vector<uint64_t>	mFrames;			// offset of every complete frame
+};
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <span>
+#include <unordered_map>
+#include <cstdint>
+#include <algorithm>
+
+#include "component.h"
+#include "hierarchy.h"
+#include "events.h"
+
+// A single read or write a scheduled task makes to a shared resource (a component field)
+struct ResourceAccess
+{
+	enum class Mode { Read, Write };
+
+	ResourceAccess(const std::string& resource, Mode mode)
+	: mResource(resource)
+	, mMode(mode)
+	{
+	}
+
+	std::string		mResource;
+	Mode			mMode;
+};
+
+// Builds a frame's task graph from the resource accesses of each task, in program order.
+// Edges are only inserted for real hazards:
+//   RAW - a read waits on the last write
+//   WAR - a write waits on every read since the last write
+//   WAW - a write with no reads in between waits on the last write
+// and a predecessor already implied by another predecessor is dropped, so every task has
+// the smallest set of dependencies that still orders all of its conflicting accesses.
+class FrameSchedule
+{
+public:
+	static constexpr uint32_t kNoTask = UINT32_MAX;
+
+	FrameSchedule()
+	: mFirstTask(0)
+	{
+	}
+
+	void Reset() {
+		mTasks.clear();
+		mResources.clear();
+		mFirstTask = 0;
+	}
+
+	// Task ids keep increasing across frames, so hazards against work still in flight from an
+	// earlier frame are ordered exactly like those within a frame.
+	uint32_t AddTask(const std::string& name, const std::vector<ResourceAccess>& accesses) {
+		const uint32_t taskId = GetEndTask();
+		mTasks.emplace_back();
+		Task& task = mTasks.back();
+		task.mName = name;
+		task.mAncestorWordBase = mFirstTask / 64;
+		task.mAncestors.resize(taskId / 64 - task.mAncestorWordBase + 1, 0);
+
+		// collapse repeated accesses to the same resource, a write wins over a read
+		for (const ResourceAccess& access : accesses) {
+			bool merged = false;
+			for (ResourceAccess& existing : task.mAccesses) {
+				if (existing.mResource == access.mResource) {
+					if (access.mMode == ResourceAccess::Mode::Write) {
+						existing.mMode = ResourceAccess::Mode::Write;
+					}
+					merged = true;
+					break;
+				}
+			}
+			if (!merged) {
+				task.mAccesses.push_back(access);
+			}
+		}
+
+		std::vector<uint32_t> candidates;
+		for (const ResourceAccess& access : task.mAccesses) {
+			ResourceState& state = mResources[access.mResource];
+
+			if (access.mMode == ResourceAccess::Mode::Read) {
+				// RAW
+				if (state.mLastWriter != kNoTask) {
+					candidates.push_back(state.mLastWriter);
+				}
+				state.mReaders.push_back(taskId);
+			}
+			else {
+				if (!state.mReaders.empty()) {
+					// WAR, every reader already waits on the last writer
+					candidates.insert(candidates.end(), state.mReaders.begin(), state.mReaders.end());
+				}
+				else if (state.mLastWriter != kNoTask) {
+					// WAW
+					candidates.push_back(state.mLastWriter);
+				}
+				state.mLastWriter = taskId;
+				state.mReaders.clear();
+			}
+		}
+
+		// drop duplicates and any candidate that another candidate already waits on
+		for (uint32_t candidate : candidates) {
+			bool redundant = false;
+			for (uint32_t other : candidates) {
+				if (other == candidate) {
+					continue;
+				}
+				if (IsAncestor(other, candidate)) {
+					redundant = true;
+					break;
+				}
+			}
+			if (!redundant && !IsAncestor(taskId, candidate)) {
+				SetAncestor(taskId, candidate);
+				task.mDependencies.push_back(candidate);
+			}
+		}
+
+		for (uint32_t dependency : task.mDependencies) {
+			const Task& inherited = GetTask(dependency);
+			for (size_t iWord = 0; iWord < inherited.mAncestors.size(); ++iWord) {
+				const uint32_t word = inherited.mAncestorWordBase + uint32_t(iWord);
+				if (word >= task.mAncestorWordBase) {
+					task.mAncestors[word - task.mAncestorWordBase] |= inherited.mAncestors[iWord];
+				}
+			}
+		}
+
+		return taskId;
+	}
+
+	// Forgets every task before endTask. Callers retire a frame once all of its jobs are done,
+	// after which nothing can conflict with them any more.
+	void Retire(uint32_t endTask) {
+		while (mFirstTask < endTask && !mTasks.empty()) {
+			mTasks.pop_front();
+			++mFirstTask;
+		}
+
+		for (auto& it : mResources) {
+			ResourceState& state = it.second;
+			if (state.mLastWriter != kNoTask && state.mLastWriter < mFirstTask) {
+				state.mLastWriter = kNoTask;
+			}
+			state.mReaders.erase(
+				std::remove_if(state.mReaders.begin(), state.mReaders.end(), [this](uint32_t t) { return t < mFirstTask; }),
+				state.mReaders.end());
+		}
+	}
+
+	uint32_t GetFirstTask() const {
+		return mFirstTask;
+	}
+
+	uint32_t GetEndTask() const {
+		return mFirstTask + uint32_t(mTasks.size());
+	}
+
+	uint32_t NumTasks() const {
+		return uint32_t(mTasks.size());
+	}
+
+	const std::string& GetName(uint32_t task) const {
+		return GetTask(task).mName;
+	}
+
+	// May include retired tasks, which are complete
+	const std::vector<uint32_t>& GetDependencies(uint32_t task) const {
+		return GetTask(task).mDependencies;
+	}
+
+	// Debug check, independent of the incremental bookkeeping: walks the graph of tasks not yet
+	// retired and confirms every pair of them with a conflicting access is ordered by some path.
+	bool Verify(std::string& error) const {
+		const uint32_t numTasks = NumTasks();
+		std::vector<uint32_t> visitedBy(numTasks, kNoTask);
+		std::vector<uint32_t> stack;
+
+		for (uint32_t later = 0; later < numTasks; ++later) {
+			// mark everything 'later' transitively waits on
+			stack.assign(mTasks[later].mDependencies.begin(), mTasks[later].mDependencies.end());
+			while (!stack.empty()) {
+				const uint32_t taskId = stack.back();
+				stack.pop_back();
+				if (taskId < mFirstTask) {
+					continue;
+				}
+				const uint32_t t = taskId - mFirstTask;
+				if (visitedBy[t] == later) {
+					continue;
+				}
+				if (t >= later) {
+					error = "dependency of " + mTasks[later].mName + " on later task " + mTasks[t].mName;
+					return false;
+				}
+				visitedBy[t] = later;
+				stack.insert(stack.end(), mTasks[t].mDependencies.begin(), mTasks[t].mDependencies.end());
+			}
+
+			for (uint32_t earlier = 0; earlier < later; ++earlier) {
+				if (visitedBy[earlier] == later) {
+					continue;
+				}
+				const std::string* resource = FindConflict(mTasks[earlier], mTasks[later]);
+				if (resource != nullptr) {
+					error = "unordered access to " + *resource + " by " + mTasks[earlier].mName + " and " + mTasks[later].mName;
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Resource accesses implied by a generated ComponentTask running on the given component system.
+	// Resources are individual member fields ("Transform.x"), so systems touching disjoint fields
+	// of the same component are not ordered; a whole-component access touches every field.
+	// Other systems' `in` reads of a double buffered component touch its previous-frame buffer
+	// ("PlayerData@prev.x") instead, which only the buffer swap writes.
+	static std::vector<ResourceAccess> GetAccesses(ComponentManager* mgr, IComponentSystem* owner, const ComponentTask& fn) {
+		std::vector<ResourceAccess> accesses;
+		const ComponentFunctionTable& functions = owner->GetComponentFunctions();
+		for (const ComponentTask::Dependency& dn : functions.GetDependencies(fn)) {
+			if (dn.mType == ComponentTask::Dependency::Type::Ctx) {
+				// the context is read-only while the frame runs
+				continue;
+			}
+			if (dn.mType == ComponentTask::Dependency::Type::SpatialIndex) {
+				// readers only see the grid the index's Build step publishes
+				accesses.emplace_back(std::string(dn.mComponentName) + kSpatialIndex, ResourceAccess::Mode::Read);
+				continue;
+			}
+			if (dn.mType == ComponentTask::Dependency::Type::EventStream) {
+				// consumers read what Publish merged, producers only touch their own pending events
+				if (dn.mDir == ComponentTask::Dependency::Direction::in) {
+					accesses.emplace_back(std::string(dn.mComponentName) + kEvents, ResourceAccess::Mode::Read);
+				}
+				else {
+					accesses.emplace_back(GetPendingEventsResource(dn.mComponentName, owner), ResourceAccess::Mode::Write);
+				}
+				continue;
+			}
+
+			const bool isThis = (dn.mType == ComponentTask::Dependency::Type::This);
+			IComponentSystem* sys = isThis ? owner : mgr->GetSystemById(dn.mComponentId);
+			const std::span<const std::string_view> members = sys ? sys->GetComponentFunctions().mMembers : std::span<const std::string_view>();
+
+			std::string resource = isThis ? owner->Name() : std::string(dn.mComponentName);
+			if (!isThis && sys && sys->IsDoubleBuffered() && dn.mDir == ComponentTask::Dependency::Direction::in) {
+				resource += kPreviousBuffer;
+			}
+
+			const std::span<const ComponentTask::Dependency::Field> fields = functions.GetFields(dn);
+			bool wholeComponent = fields.empty();
+			for (const ComponentTask::Dependency::Field& field : fields) {
+				if (std::find(members.begin(), members.end(), field.mName) == members.end()) {
+					wholeComponent = true;
+				}
+			}
+
+			if (!wholeComponent) {
+				for (const ComponentTask::Dependency::Field& field : fields) {
+					accesses.emplace_back(GetFieldResource(resource, field.mName), GetMode(field.mDir));
+				}
+			}
+			else {
+				AddWholeComponent(accesses, resource, members, GetMode(dn.mDir));
+			}
+		}
+		return accesses;
+	}
+
+	// CopyForward reads the previous buffer and rewrites the current one
+	static std::vector<ResourceAccess> GetCopyForwardAccesses(IComponentSystem* sys) {
+		std::vector<ResourceAccess> accesses;
+		const std::span<const std::string_view> members = sys->GetComponentFunctions().mMembers;
+		AddWholeComponent(accesses, sys->Name(), members, ResourceAccess::Mode::Write);
+		AddWholeComponent(accesses, sys->Name() + kPreviousBuffer, members, ResourceAccess::Mode::Read);
+		return accesses;
+	}
+
+	// Recording a frame's diff reads the current buffer once the frame's writers are done. The
+	// recorder's own copy of the component is a resource too, so recordings of one component
+	// stay in frame order even in frames that don't write it.
+	static std::vector<ResourceAccess> GetRecordAccesses(IComponentSystem* sys) {
+		std::vector<ResourceAccess> accesses;
+		const std::span<const std::string_view> members = sys->GetComponentFunctions().mMembers;
+		AddWholeComponent(accesses, sys->Name(), members, ResourceAccess::Mode::Read);
+		accesses.emplace_back(sys->Name() + kRecorder, ResourceAccess::Mode::Write);
+		return accesses;
+	}
+
+	// The allocated entity list, read by the recorder and written by command playback
+	static std::vector<ResourceAccess> GetEntityRecordAccesses() {
+		std::vector<ResourceAccess> accesses;
+		accesses.emplace_back(kEntities, ResourceAccess::Mode::Read);
+		accesses.emplace_back(std::string(kEntities) + kRecorder, ResourceAccess::Mode::Write);
+		return accesses;
+	}
+
+	// Playing back structural changes moves rows of any component and allocates entities, so it
+	// waits on every earlier task and every later one waits on it
+	static std::vector<ResourceAccess> GetPlaybackAccesses(ComponentManager* mgr) {
+		std::vector<ResourceAccess> accesses;
+		for (IComponentSystem* sys : mgr->mSystems) {
+			const std::span<const std::string_view> members = sys->GetComponentFunctions().mMembers;
+			AddWholeComponent(accesses, sys->Name(), members, ResourceAccess::Mode::Write);
+			AddWholeComponent(accesses, sys->Name() + kPreviousBuffer, members, ResourceAccess::Mode::Write);
+		}
+		accesses.emplace_back(kEntities, ResourceAccess::Mode::Write);
+		return accesses;
+	}
+
+	// A spatial index rebuild reads the positions its readers would see, from the previous buffer
+	// when double buffered. Prepare sizes every slice, each Gather fills its own slice and Build
+	// publishes the grid, so the Gather jobs run side by side.
+	static std::vector<ResourceAccess> GetSpatialPrepareAccesses(ISpatialIndex* index) {
+		std::vector<ResourceAccess> accesses = GetPositionAccesses(index);
+		for (uint32_t slice = 0; slice < ISpatialIndex::kNumSlices; ++slice) {
+			accesses.emplace_back(GetSliceResource(index, slice), ResourceAccess::Mode::Write);
+		}
+		return accesses;
+	}
+
+	static std::vector<ResourceAccess> GetSpatialGatherAccesses(ISpatialIndex* index, uint32_t slice) {
+		std::vector<ResourceAccess> accesses = GetPositionAccesses(index);
+		accesses.emplace_back(GetSliceResource(index, slice), ResourceAccess::Mode::Write);
+		return accesses;
+	}
+
+	static std::vector<ResourceAccess> GetSpatialBuildAccesses(ISpatialIndex* index) {
+		std::vector<ResourceAccess> accesses;
+		for (uint32_t slice = 0; slice < ISpatialIndex::kNumSlices; ++slice) {
+			accesses.emplace_back(GetSliceResource(index, slice), ResourceAccess::Mode::Read);
+		}
+		accesses.emplace_back(index->GetSystem()->Name() + kSpatialIndex, ResourceAccess::Mode::Write);
+		return accesses;
+	}
+
+	// Begin may recompute every child, so it claims the world transform like a writer of it.
+	// Level l reads every slice of level l - 1 and writes its own slice, so the slices of one
+	// level run side by side; the serial job after the parallel levels takes the next level.
+	static std::vector<ResourceAccess> GetHierarchyBeginAccesses(ITransformHierarchy* hierarchy) {
+		std::vector<ResourceAccess> accesses = GetHierarchyNodeAccesses(hierarchy);
+		IComponentSystem* world = hierarchy->GetWorldSystem();
+		AddWholeComponent(accesses, world->Name(), world->GetComponentFunctions().mMembers, ResourceAccess::Mode::Write);
+		accesses.emplace_back(GetLevelResource(hierarchy), ResourceAccess::Mode::Write);
+		return accesses;
+	}
+
+	static std::vector<ResourceAccess> GetHierarchyLevelAccesses(ITransformHierarchy* hierarchy, uint32_t level, uint32_t slice) {
+		std::vector<ResourceAccess> accesses = GetHierarchyNodeAccesses(hierarchy);
+		if (level == 0) {
+			accesses.emplace_back(GetLevelResource(hierarchy), ResourceAccess::Mode::Read);
+		}
+		else {
+			for (uint32_t parentSlice = 0; parentSlice < ITransformHierarchy::kNumSlices; ++parentSlice) {
+				accesses.emplace_back(GetLevelResource(hierarchy, level - 1, parentSlice), ResourceAccess::Mode::Read);
+			}
+		}
+		accesses.emplace_back(GetLevelResource(hierarchy, level, slice), ResourceAccess::Mode::Write);
+		return accesses;
+	}
+
+	// End waits on the last level, then stands for all of them as the world transform's writer
+	static std::vector<ResourceAccess> GetHierarchyEndAccesses(ITransformHierarchy* hierarchy, uint32_t lastLevel) {
+		std::vector<ResourceAccess> accesses;
+		accesses.emplace_back(GetLevelResource(hierarchy, lastLevel, 0), ResourceAccess::Mode::Read);
+		IComponentSystem* world = hierarchy->GetWorldSystem();
+		AddWholeComponent(accesses, world->Name(), world->GetComponentFunctions().mMembers, ResourceAccess::Mode::Write);
+		return accesses;
+	}
+
+	// Publish empties every producer's pending events into the published ones, so it follows the
+	// producers scheduled before it and the consumers of what it replaces
+	static std::vector<ResourceAccess> GetEventPublishAccesses(ComponentManager* mgr, IEventChannel* channel) {
+		std::vector<ResourceAccess> accesses;
+		accesses.emplace_back(channel->Name() + kEvents, ResourceAccess::Mode::Write);
+		for (IComponentSystem* sys : mgr->mSystems) {
+			const ComponentFunctionTable& functions = sys->GetComponentFunctions();
+			for (const ComponentTask::Dependency& dn : functions.mDependencies) {
+				if (dn.mType == ComponentTask::Dependency::Type::EventStream && dn.mComponentId == channel->GetTypeId()
+					&& dn.mDir != ComponentTask::Dependency::Direction::in) {
+					accesses.emplace_back(GetPendingEventsResource(channel->Name(), sys), ResourceAccess::Mode::Write);
+					break;
+				}
+			}
+		}
+		return accesses;
+	}
+
+	// SwapBuffers exchanges both buffers, so waits on every reader and writer of either
+	static std::vector<ResourceAccess> GetSwapAccesses(IComponentSystem* sys) {
+		std::vector<ResourceAccess> accesses;
+		const std::span<const std::string_view> members = sys->GetComponentFunctions().mMembers;
+		AddWholeComponent(accesses, sys->Name(), members, ResourceAccess::Mode::Write);
+		AddWholeComponent(accesses, sys->Name() + kPreviousBuffer, members, ResourceAccess::Mode::Write);
+		return accesses;
+	}
+
+private:
+	struct Task
+	{
+		std::string						mName;
+		std::vector<ResourceAccess>		mAccesses;
+		std::vector<uint32_t>			mDependencies;
+		std::vector<uint64_t>			mAncestors;			// bitset of every task this one transitively waits on
+		uint32_t						mAncestorWordBase;	// task id / 64 of mAncestors[0], older tasks were already retired
+	};
+
+	struct ResourceState
+	{
+		uint32_t						mLastWriter = kNoTask;
+		std::vector<uint32_t>			mReaders;		// readers since mLastWriter
+	};
+
+	static constexpr const char* kPreviousBuffer = "@prev";
+	static constexpr const char* kRecorder = "@recorder";
+	static constexpr const char* kEntities = "@entities";
+	static constexpr const char* kSpatialIndex = "@spatial";
+	static constexpr const char* kHierarchy = "@hierarchy";
+	static constexpr const char* kEvents = "@events";
+
+	static std::string GetFieldResource(const std::string& resource, std::string_view field) {
+		std::string fieldResource = resource;
+		fieldResource += '.';
+		fieldResource += field;
+		return fieldResource;
+	}
+
+	static std::vector<ResourceAccess> GetPositionAccesses(ISpatialIndex* index) {
+		IComponentSystem* sys = index->GetSystem();
+		const std::string resource = sys->IsDoubleBuffered() ? sys->Name() + kPreviousBuffer : sys->Name();
+		std::vector<ResourceAccess> accesses;
+		accesses.emplace_back(GetFieldResource(resource, "x"), ResourceAccess::Mode::Read);
+		accesses.emplace_back(GetFieldResource(resource, "y"), ResourceAccess::Mode::Read);
+		return accesses;
+	}
+
+	static std::string GetSliceResource(ISpatialIndex* index, uint32_t slice) {
+		return index->GetSystem()->Name() + kSpatialIndex + "#" + std::to_string(slice);
+	}
+
+	static std::vector<ResourceAccess> GetHierarchyNodeAccesses(ITransformHierarchy* hierarchy) {
+		IComponentSystem* nodes = hierarchy->GetNodeSystem();
+		std::vector<ResourceAccess> accesses;
+		AddWholeComponent(accesses, nodes->Name(), nodes->GetComponentFunctions().mMembers, ResourceAccess::Mode::Read);
+		return accesses;
+	}
+
+	static std::string GetLevelResource(ITransformHierarchy* hierarchy) {
+		return hierarchy->GetNodeSystem()->Name() + kHierarchy;
+	}
+
+	static std::string GetLevelResource(ITransformHierarchy* hierarchy, uint32_t level, uint32_t slice) {
+		return GetLevelResource(hierarchy) + "." + std::to_string(level) + "." + std::to_string(slice);
+	}
+
+	// Events a producer system emitted, not yet published
+	static std::string GetPendingEventsResource(std::string_view eventName, IComponentSystem* producer) {
+		return std::string(eventName) + kEvents + "#" + producer->Name();
+	}
+
+	static void AddWholeComponent(std::vector<ResourceAccess>& accesses, const std::string& resource, std::span<const std::string_view> members, ResourceAccess::Mode mode) {
+		if (members.empty()) {
+			accesses.emplace_back(resource, mode);
+			return;
+		}
+		for (std::string_view member : members) {
+			accesses.emplace_back(GetFieldResource(resource, member), mode);
+		}
+	}
+
+	static ResourceAccess::Mode GetMode(ComponentTask::Dependency::Direction dir) {
+		// out, inout and (conservatively) unknown all write
+		return (dir == ComponentTask::Dependency::Direction::in) ? ResourceAccess::Mode::Read : ResourceAccess::Mode::Write;
+	}
+
+	const Task& GetTask(uint32_t task) const {
+		return mTasks[task - mFirstTask];
+	}
+
+	bool IsAncestor(uint32_t task, uint32_t ancestor) const {
+		const Task& t = GetTask(task);
+		const uint32_t word = ancestor / 64;
+		if (word < t.mAncestorWordBase || word - t.mAncestorWordBase >= t.mAncestors.size()) {
+			return false;
+		}
+		return (t.mAncestors[word - t.mAncestorWordBase] & (uint64_t(1) << (ancestor % 64))) != 0;
+	}
+
+	void SetAncestor(uint32_t task, uint32_t ancestor) {
+		Task& t = mTasks[task - mFirstTask];
+		t.mAncestors[ancestor / 64 - t.mAncestorWordBase] |= uint64_t(1) << (ancestor % 64);
+	}
+
+	static const std::string* FindConflict(const Task& a, const Task& b) {
+		for (const ResourceAccess& accessA : a.mAccesses) {
+			for (const ResourceAccess& accessB : b.mAccesses) {
+				if (accessA.mResource == accessB.mResource
+					&& (accessA.mMode == ResourceAccess::Mode::Write || accessB.mMode == ResourceAccess::Mode::Write)) {
+					return &accessA.mResource;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	std::deque<Task>									mTasks;			// tasks not yet retired, starting at mFirstTask
+	uint32_t											mFirstTask;
+	std::unordered_map<std::string, ResourceState>		mResources;
+};
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "component.h"
+
+// World snapshot file: a header, a table with one entry per component system, then the entity
+// list and every system's columns as raw blobs aligned to kSnapshotAlignment. Loading maps the
+// file and copies each column into its system in one go, nothing is parsed per entity.
+//
+//   SnapshotHeader
+//   SnapshotSystem[mNumSystems]
+//   EntityId[mNumEntities]                  allocated entities
+//   per system:
+//     EntityId[mNumRows]                    row -> entity
+//     T[mNumRows]                           rows, trivially copyable components only
+//     T[mNumRows]                           previous frame, double buffered ones only
+//
+// Offsets are from the start of the file, zero when a blob is absent. Snapshots are only
+// meant to be read back by the build that wrote them, so integers are in native byte order.
+
+constexpr uint32_t kSnapshotMagic = 0x53534345;		// "ECSS"
+constexpr uint32_t kSnapshotVersion = 1;
+constexpr uint64_t kSnapshotAlignment = 64;
+
+struct SnapshotHeader
+{
+	uint32_t	mMagic;
+	uint32_t	mVersion;
+	uint32_t	mFrameIndex;
+	uint32_t	mNumEntities;
+	uint32_t	mNumSystems;
+	uint32_t	mPad;
+	uint64_t	mEntitiesOffset;
+};
+
+struct SnapshotSystem
+{
+	ComponentTypeId		mTypeId;
+	uint64_t			mSchemaHash;
+	uint32_t			mComponentSize;
+	uint32_t			mNumRows;
+	uint64_t			mEntitiesOffset;
+	uint64_t			mRowsOffset;
+	uint64_t			mPrevRowsOffset;
+};
+
+// Read-only view of a whole file, mapped where the platform allows it
+class SnapshotFile
+{
+public:
+	SnapshotFile() = default;
+	SnapshotFile(const SnapshotFile&) = delete;
+	SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+	~SnapshotFile() {
+#ifdef _WIN32
+		if (mData != nullptr) {
+			UnmapViewOfFile(mData);
+		}
+#else
+		if (mData != nullptr) {
+			munmap(const_cast<char*>(mData), mSize);
+		}
+#endif
+	}
+
+	bool Open(const std::string& path) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping != nullptr) {
+				mData = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				mSize = size_t(size.QuadPart);
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+#else
+		const int file = open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(file, &info) == 0 && info.st_size > 0) {
+			void* data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (data != MAP_FAILED) {
+				mData = static_cast<const char*>(data);
+				mSize = size_t(info.st_size);
+			}
+		}
+		close(file);
+#endif
+		return mData != nullptr;
+	}
+
+	size_t Size() const {
+		return mSize;
+	}
+
+	// Pointer to count objects of T at offset, null when they don't fit in the file
+	template< class T >
+	const T* At(uint64_t offset, uint64_t count) const {
+		if (offset > mSize || count > (mSize - offset) / sizeof(T) || offset % alignof(T) != 0) {
+			return nullptr;
+		}
+		return reinterpret_cast<const T*>(mData + offset);
+	}
+
+private:
+	const char*		mData = nullptr;
+	size_t			mSize = 0;
+};
+
+// Writes every entity and component system of the world. Must not run while frames are in flight.
+inline bool SaveWorldSnapshot(EntityManager& entityManager, const std::string& path, std::string& error) {
+	ComponentManager* mgr = entityManager.GetComponentMgr();
+	const std::span<const EntityId> entities = entityManager.GetEntities();
+
+	auto align = [](uint64_t offset) { return (offset + kSnapshotAlignment - 1) / kSnapshotAlignment * kSnapshotAlignment; };
+
+	SnapshotHeader header = {};
+	header.mMagic = kSnapshotMagic;
+	header.mVersion = kSnapshotVersion;
+	header.mFrameIndex = entityManager.GetContext().frameIndex;
+	header.mNumEntities = uint32_t(entities.size());
+	header.mNumSystems = uint32_t(mgr->mSystems.size());
+
+	// lay the blobs out first, so the file is written front to back in one pass
+	uint64_t offset = align(sizeof(SnapshotHeader) + header.mNumSystems * sizeof(SnapshotSystem));
+	header.mEntitiesOffset = offset;
+	offset = align(offset + entities.size_bytes());
+
+	std::vector<SnapshotSystem> systems;
+	std::vector<std::span<const char>> blobs;
+	blobs.push_back(std::span<const char>(reinterpret_cast<const char*>(entities.data()), entities.size_bytes()));
+	for (IComponentSystem* sys : mgr->mSystems) {
+		SnapshotSystem entry = {};
+		entry.mTypeId = sys->GetTypeId();
+		entry.mSchemaHash = sys->GetSchemaHash();
+		entry.mComponentSize = sys->GetComponentSize();
+		entry.mNumRows = sys->NumComponents();
+
+		auto addBlob = [&](const void* data, uint64_t size) {
+			const uint64_t blobOffset = offset;
+			blobs.push_back(std::span<const char>(static_cast<const char*>(data), size));
+			offset = align(offset + size);
+			return blobOffset;
+		};
+		entry.mEntitiesOffset = addBlob(sys->GetEntities().data(), sys->GetEntities().size_bytes());
+		const uint64_t rowsSize = uint64_t(entry.mNumRows) * entry.mComponentSize;
+		if (const void* rows = sys->GetRowBytes(false)) {
+			entry.mRowsOffset = addBlob(rows, rowsSize);
+		}
+		if (const void* prevRows = sys->GetRowBytes(true)) {
+			entry.mPrevRowsOffset = addBlob(prevRows, rowsSize);
+		}
+		systems.push_back(entry);
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		error = "cannot open " + path + " for writing";
+		return false;
+	}
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(systems.data()), std::streamsize(systems.size() * sizeof(SnapshotSystem)));
+	static const char kPadding[kSnapshotAlignment] = {};
+	for (std::span<const char> blob : blobs) {
+		const uint64_t written = uint64_t(out.tellp());
+		out.write(kPadding, std::streamsize(align(written) - written));
+		out.write(blob.data(), std::streamsize(blob.size()));
+	}
+	if (!out) {
+		error = "failed writing " + path;
+		return false;
+	}
+	return true;
+}
+
+// Replaces the world with a snapshot. Every registered system must match the layout it was
+// saved with; systems missing from the snapshot are emptied. On failure the world is unchanged.
+// Must not run while frames are in flight.
+inline bool LoadWorldSnapshot(EntityManager& entityManager, const std::string& path, std::string& error) {
+	SnapshotFile file;
+	if (!file.Open(path)) {
+		error = "cannot map " + path;
+		return false;
+	}
+
+	const SnapshotHeader* header = file.At<SnapshotHeader>(0, 1);
+	if (header == nullptr || header->mMagic != kSnapshotMagic || header->mVersion != kSnapshotVersion) {
+		error = path + " is not a world snapshot of this version";
+		return false;
+	}
+	const SnapshotSystem* systems = file.At<SnapshotSystem>(sizeof(SnapshotHeader), header->mNumSystems);
+	const EntityId* entities = file.At<EntityId>(header->mEntitiesOffset, header->mNumEntities);
+	if (systems == nullptr || entities == nullptr) {
+		error = path + " is truncated";
+		return false;
+	}
+
+	// check everything before touching the world
+	ComponentManager* mgr = entityManager.GetComponentMgr();
+	std::vector<const SnapshotSystem*> entries;
+	for (IComponentSystem* sys : mgr->mSystems) {
+		const SnapshotSystem* entry = nullptr;
+		for (uint32_t i = 0; i < header->mNumSystems; ++i) {
+			if (systems[i].mTypeId == sys->GetTypeId()) {
+				entry = &systems[i];
+			}
+		}
+		if (entry != nullptr) {
+			if (entry->mSchemaHash != sys->GetSchemaHash() || entry->mComponentSize != sys->GetComponentSize()) {
+				error = sys->Name() + " changed since the snapshot was saved";
+				return false;
+			}
+			const bool hasRows = (entry->mRowsOffset != 0);
+			const bool hasPrevRows = (entry->mPrevRowsOffset != 0);
+			if (hasRows != sys->IsTriviallyCopyable() || hasPrevRows != (hasRows && sys->IsDoubleBuffered())) {
+				error = sys->Name() + " columns don't match the snapshot";
+				return false;
+			}
+			const uint64_t rowsSize = uint64_t(entry->mNumRows) * entry->mComponentSize;
+			if (file.At<EntityId>(entry->mEntitiesOffset, entry->mNumRows) == nullptr
+				|| (hasRows && file.At<char>(entry->mRowsOffset, rowsSize) == nullptr)
+				|| (hasPrevRows && file.At<char>(entry->mPrevRowsOffset, rowsSize) == nullptr)) {
+				error = path + " is truncated";
+				return false;
+			}
+		}
+		entries.push_back(entry);
+	}
+
+	entityManager.AdoptEntities(std::span<const EntityId>(entities, header->mNumEntities), header->mFrameIndex);
+	for (size_t i = 0; i < mgr->mSystems.size(); ++i) {
+		IComponentSystem* sys = mgr->mSystems[i];
+		const SnapshotSystem* entry = entries[i];
+		if (entry == nullptr) {
+			sys->Adopt({}, nullptr, nullptr);
+			continue;
+		}
+		const uint64_t rowsSize = uint64_t(entry->mNumRows) * entry->mComponentSize;
+		sys->Adopt(std::span<const EntityId>(file.At<EntityId>(entry->mEntitiesOffset, entry->mNumRows), entry->mNumRows),
+			entry->mRowsOffset != 0 ? file.At<char>(entry->mRowsOffset, rowsSize) : nullptr,
+			entry->mPrevRowsOffset != 0 ? file.At<char>(entry->mPrevRowsOffset, rowsSize) : nullptr);
+	}
+	return true;
+}
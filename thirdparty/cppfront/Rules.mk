@@ -18,3 +18,44 @@ cppfront: ./thirdparty/cppfront/source/cppfront.cpp ./thirdparty/cppfront/source
 
   
 
+# Translates the same files sequentially, then several times with -jobs, and fails unless every
+# run prints and writes exactly what the sequential one did. Repeated inputs make each worker
+# translate more than one file.
+CPPFRONT_CHECK_DIR := $(BASE_OBJ)/cppfront-jobs-check
+CPPFRONT_CHECK_WIN := $(subst /,\,$(CPPFRONT_CHECK_DIR))
+CPPFRONT_CHECK_INPUTS := $(addprefix $(CPPFRONT_CHECK_DIR)/,1_reflect.h2 2_reflect.h2 3_reflect.h2 4_reflect.h2 mycomponent.cpp2 pure2-hello.cpp2)
+
+# $(1) flags, $(2) name of the run's listing
+define cppfront_check_run
+	@del /Q $(CPPFRONT_CHECK_WIN)\*.h $(CPPFRONT_CHECK_WIN)\*.cpp >NUL 2>NUL
+	-@./bin/cppfront $(1) $(CPPFRONT_CHECK_INPUTS) > $(CPPFRONT_CHECK_WIN)\$(2).txt 2>&1
+	@type $(CPPFRONT_CHECK_WIN)\*.h $(CPPFRONT_CHECK_WIN)\*.cpp >> $(CPPFRONT_CHECK_WIN)\$(2).txt 2>NUL
+endef
+
+.PHONY: cppfront-jobs-check
+cppfront-jobs-check: cppfront
+	@IF NOT EXIST $(CPPFRONT_CHECK_WIN) mkdir $(CPPFRONT_CHECK_WIN) >NUL 2>NUL
+	@FOR %i IN (1 2 3 4) DO @copy /Y thirdparty\cppfront\source\reflect.h2 $(CPPFRONT_CHECK_WIN)\%i_reflect.h2 >NUL
+	@copy /Y src\mycomponent.cpp2 $(CPPFRONT_CHECK_WIN) >NUL
+	@copy /Y src\pure2-hello.cpp2 $(CPPFRONT_CHECK_WIN) >NUL
+	$(call cppfront_check_run,,sequential)
+	$(call cppfront_check_run,-jobs 2,jobs2a)
+	$(call cppfront_check_run,-jobs 2,jobs2b)
+	$(call cppfront_check_run,-jobs 2,jobs2c)
+	$(call cppfront_check_run,-jobs 4,jobs4)
+	fc /B $(CPPFRONT_CHECK_WIN)\sequential.txt $(CPPFRONT_CHECK_WIN)\jobs2a.txt
+	fc /B $(CPPFRONT_CHECK_WIN)\sequential.txt $(CPPFRONT_CHECK_WIN)\jobs2b.txt
+	fc /B $(CPPFRONT_CHECK_WIN)\sequential.txt $(CPPFRONT_CHECK_WIN)\jobs2c.txt
+	fc /B $(CPPFRONT_CHECK_WIN)\sequential.txt $(CPPFRONT_CHECK_WIN)\jobs4.txt
+
+# Translates a component whose parameter type is not a @component, which cppfront accepts, and
+# fails unless compiling the generated shims stops at their static_assert
+COMPONENT_CHECK_DIR := $(BASE_OBJ)/component-param-check
+COMPONENT_CHECK_WIN := $(subst /,\,$(COMPONENT_CHECK_DIR))
+
+.PHONY: component-param-check
+component-param-check: cppfront
+	@IF NOT EXIST $(COMPONENT_CHECK_WIN) mkdir $(COMPONENT_CHECK_WIN) >NUL 2>NUL
+	@copy /Y thirdparty\cppfront\checks\component-param-not-component.cpp2 $(COMPONENT_CHECK_WIN) >NUL
+	./bin/cppfront $(COMPONENT_CHECK_DIR)/component-param-not-component.cpp2
+	@cl /Zs /I ./src/ /I ./thirdparty/cppfront/include/ -std:c++20 -EHsc $(COMPONENT_CHECK_DIR)/component-param-not-component.cpp > $(COMPONENT_CHECK_WIN)\cl.txt 2>&1 && (type $(COMPONENT_CHECK_WIN)\cl.txt & echo component-param-check: a non-component parameter compiled & exit 1) || findstr /C:"int is not a @component type" $(COMPONENT_CHECK_WIN)\cl.txt
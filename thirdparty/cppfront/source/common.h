@@ -35,6 +35,21 @@
 #include <compare>
 #include <algorithm>
 #include <unordered_map>
+#include <bit>
+
+//  The lexer scans whitespace and identifier/number runs 32 or 16 chars at
+//  a time where AVX2 or SSE2 is available at compile time (SSE2 always is
+//  on x64); define CPP2_NO_SIMD to force the scalar loops
+#if !defined(CPP2_NO_SIMD)
+    #if defined(__AVX2__)
+        #define CPP2_SIMD_AVX2 1
+        #include <immintrin.h>
+    #endif
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define CPP2_SIMD_SSE2 1
+        #include <emmintrin.h>
+    #endif
+#endif
 
 namespace cpp2 {
 
@@ -46,7 +61,9 @@ namespace cpp2 {
 //
 struct source_line
 {
-    std::string text;
+    //  A view of the line's text, which is owned elsewhere: by the
+    //  source's mapped file, or by stable generated storage
+    std::string_view text;
 
     enum class category { empty, preprocessor, comment, import, cpp1, cpp2, rawstring };
     category cat;
@@ -358,6 +375,133 @@ auto is_identifier_continue(char c)
         ;
 }
 
+
+//-----------------------------------------------------------------------
+//
+//  Character run scanning: scan_run<Class>(s, pos) returns the end of the
+//  run of Class characters starting at pos, testing a whole vector of
+//  characters per step where SIMD is available and finishing the tail
+//  (and every char on other targets) with the scalar predicate
+//
+//  Each class's vector tests must agree exactly with its scalar test,
+//  which is the same predicate the lexer uses one char at a time
+//
+//-----------------------------------------------------------------------
+//
+
+//  SIMD has no unsigned byte compare, so lo <= c <= lo+span is tested as
+//  min(c-lo, span) == c-lo on the wrapped difference
+#if CPP2_SIMD_SSE2
+inline auto sse2_in_range(__m128i v, char lo, char span)
+    -> __m128i
+{
+    auto d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(span)), d);
+}
+#endif
+#if CPP2_SIMD_AVX2
+inline auto avx2_in_range(__m256i v, char lo, char span)
+    -> __m256i
+{
+    auto d = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(span)), d);
+}
+#endif
+
+//  ' ' and '\t' '\n' '\v' '\f' '\r', as isspace in the "C" locale
+struct whitespace_chars
+{
+    static auto scalar(char c) -> bool { return isspace(c); }
+#if CPP2_SIMD_SSE2
+    static auto sse2(__m128i v) -> __m128i {
+        return _mm_or_si128( sse2_in_range(v, '\t', 4), _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')) );
+    }
+#endif
+#if CPP2_SIMD_AVX2
+    static auto avx2(__m256i v) -> __m256i {
+        return _mm256_or_si256( avx2_in_range(v, '\t', 4), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')) );
+    }
+#endif
+};
+
+//  identifier-continue: digits, letters, and _
+//  ('A'..'Z' | 0x20 is 'a'..'z', and no other byte maps into that range)
+struct identifier_continue_chars
+{
+    static auto scalar(char c) -> bool { return is_identifier_continue(c); }
+#if CPP2_SIMD_SSE2
+    static auto sse2(__m128i v) -> __m128i {
+        return _mm_or_si128(
+            _mm_or_si128( sse2_in_range(v, '0', 9), sse2_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 25) ),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))
+        );
+    }
+#endif
+#if CPP2_SIMD_AVX2
+    static auto avx2(__m256i v) -> __m256i {
+        return _mm256_or_si256(
+            _mm256_or_si256( avx2_in_range(v, '0', 9), avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 25) ),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'))
+        );
+    }
+#endif
+};
+
+//  The digits of a decimal literal, with ' digit separators
+struct digit_or_separator_chars
+{
+    static auto scalar(char c) -> bool { return c == '\'' || is_digit(c); }
+#if CPP2_SIMD_SSE2
+    static auto sse2(__m128i v) -> __m128i {
+        return _mm_or_si128( sse2_in_range(v, '0', 9), _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')) );
+    }
+#endif
+#if CPP2_SIMD_AVX2
+    static auto avx2(__m256i v) -> __m256i {
+        return _mm256_or_si256( avx2_in_range(v, '0', 9), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')) );
+    }
+#endif
+};
+
+template<typename Class>
+auto scan_run(std::string_view s, std::size_t pos)
+    -> std::size_t
+{
+    [[maybe_unused]] auto const data = s.data();
+    auto const size = s.size();
+
+#if CPP2_SIMD_AVX2
+    while (pos + 32 <= size) {
+        auto v = _mm256_loadu_si256( reinterpret_cast<__m256i const*>(data + pos) );
+        auto outside = ~static_cast<std::uint32_t>( _mm256_movemask_epi8(Class::avx2(v)) );
+        if (outside) {
+            return pos + std::countr_zero(outside);
+        }
+        pos += 32;
+    }
+#endif
+#if CPP2_SIMD_SSE2
+    while (pos + 16 <= size) {
+        auto v = _mm_loadu_si128( reinterpret_cast<__m128i const*>(data + pos) );
+        auto outside = ~static_cast<std::uint32_t>( _mm_movemask_epi8(Class::sse2(v)) ) & 0xFFFFu;
+        if (outside) {
+            return pos + std::countr_zero(outside);
+        }
+        pos += 16;
+    }
+#endif
+
+    while (
+        pos < size
+        && Class::scalar(s[pos])
+        )
+    {
+        ++pos;
+    }
+    return pos;
+}
+
+
 //G identifier:
 //G     identifier-start
 //G     identifier identifier-continue
@@ -367,15 +511,7 @@ auto starts_with_identifier(std::string_view s)
     -> int
 {
     if (is_identifier_start(s[0])) {
-        auto j = 1;
-        while (
-            j < std::ssize(s)
-            && is_identifier_continue(s[j])
-            )
-        {
-            ++j;
-        }
-        return j;
+        return unsafe_narrow<int>( scan_run<identifier_continue_chars>(s, 1) );
     }
     return 0;
 };
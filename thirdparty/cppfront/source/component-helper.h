@@ -31,18 +31,38 @@ namespace cpp2 {
 //
 	
 
-//  parse_params takes a meta::function_declaration and parses out the parameters
+//  parse_params takes a meta::function_declaration and classifies its parameters from the
+//  parsed parameter_declaration_node data:
+//
+//    this                          This
+//    in ctx : ECS_Context          Ctx, must be `in` since the context is shared by every job
+//    xform : Transform             MyComponent, the same entity's component
+//    all : ComponentSystem<T>      AllComponents, every component of type T. When `in` and T is
+//                                  double buffered it is scheduled against the previous frame,
+//                                  so the body reads it with GetRead / GetReadAt
+//    in near : SpatialIndex<T>     SpatialIndex, positions of every T, must be `in` since the
+//                                  index is rebuilt by the scheduler, not by its readers
+//    events : EventStream<T>       EventStream, `inout` emits events of type T and `in` reads the
+//                                  ones published by earlier update steps. Not `out`, which Cpp2
+//                                  requires to be assigned before any use.
+//    in q : ComponentQuery<T...>   Query, the cached entities having every T, must be `in` since
+//                                  it reads each of the components whole
+//
+//  Anything else (wildcard or deduced types, pointers, qualified or other template types,
+//  copy/move/forward passing) is an error, since an unknown parameter would leave the
+//  scheduler without the dependency edge it needs.
 class parse_params
 {
 public:
 	struct Param
 	{
 		enum class Direction { in, out, inout };
-		enum class Type { Unknown, This, Ctx, MyComponent, AllComponents };
-		Direction		m_dir;
-		Type			m_type;
-		std::string		m_typeName;
-		std::string		m_name;
+		enum class Type { Unknown, This, Ctx, MyComponent, AllComponents, SpatialIndex, EventStream, Query };
+		Direction					m_dir;
+		Type						m_type;
+		std::string					m_typeName;		// template arguments of a Query, comma separated
+		std::string					m_name;
+		std::vector<std::string>	m_queryTypes;	// components of a Query
 	};
 
 	bool								m_started;
@@ -51,10 +71,7 @@ public:
 	std::string							m_errorMsg;
 
 	int									m_declarationDepth;
-	bool								m_parsingParam;
-	bool								m_parsingParamType;
-	bool								m_parsingParamTypeTemplateArgs;
-	Param								m_current;
+	bool								m_parsingParamList;
 
 	std::string							m_functionId;
 	std::vector< Param >				m_params;
@@ -62,330 +79,315 @@ public:
 	parse_params()
 	: m_started(false)
 	, m_ended(false)
-	, m_parsingParam(false)
-	, m_parsingParamType(false)
-	, m_parsingParamTypeTemplateArgs(false)
 	, m_error(false)
 	, m_declarationDepth(0)
+	, m_parsingParamList(false)
 	, m_functionId("")
 	{
 	}
 
-	auto start(token const& n, int indent) -> void
+	auto start(declaration_node const& n, int indent) -> void
 	{
-		auto t = n.type();
-		std::string txt = n.to_string(true);
-
-		if (m_started) {
-			if (m_parsingParam) {
-				if (m_parsingParamType) {
-					if (m_parsingParamTypeTemplateArgs) {
-						m_current.m_typeName = txt;
-						//TODO: check template name
-						m_current.m_type = Param::Type::AllComponents;
-					}
-					else {
-						m_current.m_typeName = txt;
-						if (txt == "ECS_Context") {
-							m_current.m_type = Param::Type::Ctx;
-						} else if (txt == "_") {
-							if (m_current.m_name == "this") {
-								m_current.m_type = Param::Type::This;
-							}
-							// otherwise this will be an error eventually
-						} else {
-							m_current.m_type = Param::Type::MyComponent;
-						}
-					}
-				}
-				else {
-					m_current.m_name = txt;
-				}
-			}
-			else if (m_declarationDepth == 1) {
-				if (m_functionId == "") {
-					m_functionId = txt;
+		if (!m_started) {
+			m_started = true;
+			m_declarationDepth = 0;
+		}
+		m_declarationDepth++;
+
+		if (m_declarationDepth == 1) {
+			if (n.type.index() == declaration_node::a_function) {
+				if (n.name()) {
+					m_functionId = n.name()->to_string(true);
 				}
-				// otherwise could be in function body... maybe handle that with flag...
+			} else {
+				set_error("Passed declaration_node is not a function");
 			}
 		}
-
-		//o << pre(indent) << n.to_string() << "\n";
-	}
-
-	auto start(literal_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "literal" << "\n";
 	}
 
-	auto start(expression_node const& n, int indent) -> void
-	{
-		//o << pre(indent) << "expression - "
-		//	<< n.num_subexpressions << " subexpressions, my_statement ["
-		//	<< static_cast<void const*>(n.my_statement) << "]\n";
-	}
-
-	auto start(expression_list_node::term const& n, int indent) -> void
-	{
-		//o << pre(indent) << "expression-list term\n";
-		//if (n.pass == passing_style::out) {
-		//	o << pre(indent + 1) << "out\n";
-		//}
-	}
-
-	auto start(expression_list_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "expression-list\n";
-	}
-
-	auto start(primary_expression_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "primary-expression\n";
-	}
-
-	auto start(prefix_expression_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "prefix-expression\n";
-	}
-
-	auto start(is_as_expression_node const&, int indent) -> void
+	auto end(declaration_node const& n, int) -> void
 	{
-		//o << pre(indent) << "is-as-expression\n";
+		m_declarationDepth--;
+		if (m_declarationDepth == 0) {
+			m_ended = true;
+		}
+		if (m_declarationDepth < 0) {
+			//don't think this can happen
+			set_error("Mismatched declaration node start-end");
+		}
 	}
 
-	template<String Name, typename Term>
-	auto start(binary_expression_node<Name, Term> const&, int indent) -> void
+	//  Only the function's own parameter list, not those of for loops or nested functions
+	auto start(parameter_declaration_list_node const&, int indent) -> void
 	{
-		//o << pre(indent) << Name.value << "-expression\n";
+		if (m_declarationDepth == 1 && m_params.empty()) {
+			m_parsingParamList = true;
+		}
 	}
 
-	auto start(expression_statement_node const& n, int indent) -> void
+	auto end(parameter_declaration_list_node const&, int indent) -> void
 	{
-		//o << pre(indent) << "expression-statement - [" << static_cast<void const*>(&n) << "]\n";
+		m_parsingParamList = false;
 	}
 
-	auto start(postfix_expression_node const&, int indent) -> void
+	auto start(parameter_declaration_node const& n, int indent) -> void
 	{
-		//o << pre(indent) << "postfix-expression\n";
-	}
+		if (!m_parsingParamList || m_declarationDepth != 1) {
+			return;
+		}
 
-	auto start(unqualified_id_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "unqualified-id\n";
-	}
+		assert(n.declaration);
+		Param param = { Param::Direction::in, Param::Type::Unknown, "", "", {} };
+		if (n.has_name()) {
+			param.m_name = n.name()->to_string(true);
+		}
 
-	auto start(qualified_id_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "qualified-id\n";
-	}
+		switch (n.pass) {
+		break; case passing_style::in: param.m_dir = Param::Direction::in;
+		break; case passing_style::inout: param.m_dir = Param::Direction::inout;
+		break; case passing_style::out: param.m_dir = Param::Direction::out;
+		break; default: set_error("Parameter '" + param.m_name + "' must be passed in, inout or out");
+		}
 
-	auto start(type_id_node const&, int indent) -> void
-	{
-		if (m_parsingParam) {
-			m_parsingParamType = true;
+		if (n.has_name("this")) {
+			param.m_type = Param::Type::This;
+		}
+		else {
+			classify_type(param, n.declaration->get_object_type());
 		}
-	}
 
-	auto end(type_id_node const&, int indent) -> void
-	{
-		if (m_parsingParam) {
-			m_parsingParamType = false;
+		for (auto const& other : m_params) {
+			if (other.m_name == param.m_name) {
+				set_error("Duplicate parameter '" + param.m_name + "'");
+			}
 		}
+		m_params.push_back(param);
 	}
 
-
-	auto start(id_expression_node const&, int indent) -> void
+	auto start(auto const&, int indent) -> void
 	{
-		//o << pre(indent) << "id-expression\n";
+		//  Ignore other node types
 	}
 
-	auto start(statement_node const&, int indent) -> void
+	auto end(auto const&, int) -> void
 	{
-		//o << pre(indent) << "statement\n";
+		//  Ignore other node types
 	}
 
-	auto start(compound_statement_node const&, int indent) -> void
+private:
+	auto set_error(std::string const& msg) -> void
 	{
-		//o << pre(indent) << "compound-statement\n";
+		//  Keep the first error, later ones are usually a consequence of it
+		if (!m_error) {
+			m_error = true;
+			m_errorMsg = msg;
+		}
 	}
 
-	auto start(selection_statement_node const& n, int indent) -> void
+	auto template_arg_name(Param const& param, std::string const& templateName, auto const& arg) -> std::string
 	{
-		//o << pre(indent) << "selection-statement\n";
-		//o << pre(indent + 1) << "is_constexpr: " << __as<std::string>(n.is_constexpr) << "\n";
+		//  a plain name argument parses as an id-expression rather than a type-id
+		if (arg.index() == unqualified_id_node::type_id) {
+			return std::get<unqualified_id_node::type_id>(arg)->to_string();
+		}
+		if (arg.index() == unqualified_id_node::expression && std::get<unqualified_id_node::expression>(arg)->is_id_expression()) {
+			return std::get<unqualified_id_node::expression>(arg)->to_string();
+		}
+		set_error("Parameter '" + param.m_name + "' " + templateName + " argument must name a component type");
+		return "";
 	}
 
-	auto start(alternative_node const&, int indent) -> void
+	auto classify_type(Param& param, type_id_node const* type) -> void
 	{
-		//o << pre(indent) << "alternative\n";
-	}
+		if (!type || type->is_wildcard()) {
+			set_error("Parameter '" + param.m_name + "' needs an explicit component, ComponentSystem<T>, SpatialIndex<T>, EventStream<T>, ComponentQuery<T...> or ECS_Context type");
+			return;
+		}
+		if (!type->pc_qualifiers.empty() || type->id.index() != type_id_node::unqualified) {
+			set_error("Parameter '" + param.m_name + "' type '" + type->to_string() + "' is not a component, ComponentSystem<T>, SpatialIndex<T>, EventStream<T>, ComponentQuery<T...> or ECS_Context");
+			return;
+		}
 
-	auto start(jump_statement_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "jump\n";
-	}
+		auto const& id = *std::get<type_id_node::unqualified>(type->id);
+		std::string name = id.identifier->to_string(true);
 
-	auto start(inspect_expression_node const& n, int indent) -> void
-	{
-		//o << pre(indent) << "inspect-expression\n";
-		//o << pre(indent + 1) << "is_constexpr: " << __as<std::string>(n.is_constexpr) << "\n";
+		if (id.template_args.empty()) {
+			param.m_typeName = name;
+			param.m_type = (name == "ECS_Context") ? Param::Type::Ctx : Param::Type::MyComponent;
+			if (param.m_type == Param::Type::Ctx && param.m_dir != Param::Direction::in) {
+				set_error("Parameter '" + param.m_name + "' of type ECS_Context must be passed in");
+			}
+		}
+		else if (name == "ComponentQuery") {
+			param.m_type = Param::Type::Query;
+			if (param.m_dir != Param::Direction::in) {
+				set_error("Parameter '" + param.m_name + "' of type ComponentQuery must be passed in");
+			}
+			for (auto const& arg : id.template_args) {
+				std::string argName = template_arg_name(param, name, arg.arg);
+				param.m_typeName += (param.m_typeName.empty() ? "" : ", ") + argName;
+				param.m_queryTypes.push_back(argName);
+			}
+		}
+		else if ((name == "ComponentSystem" || name == "SpatialIndex" || name == "EventStream") && id.template_args.size() == 1) {
+			param.m_typeName = template_arg_name(param, name, id.template_args.front().arg);
+			if (name == "ComponentSystem") {
+				param.m_type = Param::Type::AllComponents;
+			}
+			else if (name == "SpatialIndex") {
+				param.m_type = Param::Type::SpatialIndex;
+				if (param.m_dir != Param::Direction::in) {
+					set_error("Parameter '" + param.m_name + "' of type SpatialIndex must be passed in");
+				}
+			}
+			else {
+				param.m_type = Param::Type::EventStream;
+				if (param.m_dir == Param::Direction::out) {
+					set_error("Parameter '" + param.m_name + "' of type EventStream must be passed inout to emit or in to read");
+				}
+			}
+		}
+		else {
+			set_error("Parameter '" + param.m_name + "' type '" + type->to_string() + "' is not a component, ComponentSystem<T>, SpatialIndex<T>, EventStream<T>, ComponentQuery<T...> or ECS_Context");
+		}
 	}
+};
 
-	auto start(return_statement_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "return-statement\n";
-	}
 
-	auto start(iteration_statement_node const& n, int indent) -> void
+//  parse_field_accesses walks a function body and records which member fields of each
+//  component parameter are read and written, so the scheduler can order systems per field.
+//
+//  A field counts as written when it is an assignment target, passed as out/move/forward,
+//  has a postfix operator or call applied, or is passed as an argument to any call not made
+//  through the (pure) ECS_Context, a SpatialIndex, whose queries only read the index, an
+//  EventStream, which copies what it emits, or an `in` ComponentQuery.
+//  A parameter used other than through a plain field (passed whole, member function called,
+//  address taken...) is recorded as a whole-component access in its declared direction.
+class parse_field_accesses
+{
+public:
+	struct Field
 	{
-		//o << pre(indent) << "iteration-statement\n";
-		//assert(n.identifier);
-		//o << pre(indent + 1) << "identifier: " << std::string_view(*n.identifier) << "\n";
-
-	}
+		std::string						m_name;
+		bool							m_written;
+	};
 
-	auto start(contract_node const& n, int indent) -> void
+	struct ParamAccess
 	{
-		//o << pre(indent) << "contract\n";
-		//assert(n.kind);
-		//o << pre(indent + 1) << "kind: " << std::string_view(*n.kind) << "\n";
-		//if (n.message) {
-		//	o << pre(indent + 1) << "message: " << std::string_view(*n.message) << "\n";
-		//}
-		//if (!n.captures.members.empty()) {
-		//	o << pre(indent + 1) << "captures: " << n.captures.members.size() << "\n";
-		//}
-	}
+		std::string						m_name;
+		bool							m_writable;		// declared out or inout
+		bool							m_whole;		// used other than through a plain field
+		std::vector< Field >			m_fields;
+	};
 
-	auto start(type_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "user-defined type\n";
-	}
+	std::vector< ParamAccess >			m_params;
+	std::vector< std::string >			m_pureRoots;	// parameters whose member calls never modify their arguments
 
-	auto start(namespace_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "namespace\n";
-	}
+	std::vector< source_position >		m_writeTargets;	// positions of assignment targets and out/move/forward arguments
+	std::vector< bool >					m_impureCalls;	// per enclosing postfix-expression: may the call modify its arguments
 
-	auto start(function_type_node const& n, int indent) -> void
+	parse_field_accesses(std::vector< parse_params::Param > const& params)
 	{
-		//o << pre(indent) << "function\n";
-		//o << pre(indent + 1) << "throws: " << __as<std::string>(n.throws) << "\n";
-		//if (n.returns.index() == function_type_node::id) {
-		//	auto& r = std::get<function_type_node::id>(n.returns);
-		//	if (r.pass != passing_style::invalid) {
-		//		o << pre(indent + 1) << "returns by: " << to_string_view(r.pass) << "\n";
-		//	}
-		//}
+		for (auto const& param : params) {
+			if (param.m_type == parse_params::Param::Type::Ctx || param.m_type == parse_params::Param::Type::SpatialIndex
+				|| param.m_type == parse_params::Param::Type::EventStream || param.m_type == parse_params::Param::Type::Query) {
+				m_pureRoots.push_back(param.m_name);
+			}
+			else if (param.m_type == parse_params::Param::Type::MyComponent) {
+				m_params.push_back({ param.m_name, param.m_dir != parse_params::Param::Direction::in, false, {} });
+			}
+		}
 	}
 
-	auto start(function_returns_tag const&, int indent) -> void
+	auto find_param(std::string const& name) -> ParamAccess*
 	{
-		//o << pre(indent) << "function returns\n";
+		for (auto& p : m_params) {
+			if (p.m_name == name) {
+				return &p;
+			}
+		}
+		return nullptr;
 	}
 
-	auto start(alias_node const& n, int indent) -> void
+	auto is_write_target(source_position pos) const -> bool
 	{
-		//o << pre(indent) << "alias\n";
-		//switch (n.initializer.index()) {
-		//break; case alias_node::a_type:
-		//	o << pre(indent + 1) << "type\n";
-		//break; case alias_node::a_namespace:
-		//	o << pre(indent + 1) << "namespace\n";
-		//break; case alias_node::an_object:
-		//	o << pre(indent + 1) << "object\n";
-		//break; default:
-		//	o << pre(indent + 1) << "ICE - invalid variant state\n";
-		//}
+		return std::find(m_writeTargets.begin(), m_writeTargets.end(), pos) != m_writeTargets.end();
 	}
 
-	auto start(declaration_node const& n, int indent) -> void
+	auto record(ParamAccess& p, std::string const& field, bool written) -> void
 	{
-		if (!m_started) {
-			m_started = true;
-			m_declarationDepth = 0;
-		}
-		m_declarationDepth++;
-
-		if (m_declarationDepth == 1) {
-			if (n.type.index() == declaration_node::a_function) {
-
-			} else {
-				m_error = true;
-				m_errorMsg = "Passed declaration_node is not a function";
+		for (auto& f : p.m_fields) {
+			if (f.m_name == field) {
+				f.m_written = f.m_written || written;
+				return;
 			}
 		}
+		p.m_fields.push_back({ field, written });
 	}
 
-	auto end(declaration_node const& n, int) -> void
-	{
-		m_declarationDepth--;
-		if (m_declarationDepth == 0) {
-			m_ended = true;
-		}
-		if (m_declarationDepth < 0) {
-			//don't think this can happen
-			m_error = true;
-			m_errorMsg = "Mismatched declaration node start-end";
+	template<String Name, typename Term>
+	auto start(binary_expression_node<Name, Term> const& n, int) -> void
+	{
+		if constexpr (std::string_view(Name.value) == "assignment") {
+			//  every operand but the last of a (right-associative) assignment chain is a target
+			if (!n.terms.empty()) {
+				m_writeTargets.push_back(n.expr->position());
+				for (auto i = 0; i + 1 < std::ssize(n.terms); ++i) {
+					m_writeTargets.push_back(n.terms[i].expr->position());
+				}
+			}
 		}
 	}
 
-	auto start(parameter_declaration_node const& n, int indent) -> void
+	auto start(expression_list_node::term const& n, int) -> void
 	{
-		if (m_parsingParam) {
-			m_error = true; m_errorMsg = "Nested parameter_declaration_node";
-		}
-
-		m_parsingParam = true;
-
-		//TODO: not clear we cover all paths here to init this to something real
-		m_current.m_type = Param::Type::Unknown;
-
-		//o << pre(indent + 1);
-		switch (n.pass) {
-		break; case passing_style::in: m_current.m_dir = Param::Direction::in;
-		break; case passing_style::inout: m_current.m_dir = Param::Direction::inout;
-		break; case passing_style::out: m_current.m_dir = Param::Direction::out;
-		break; case passing_style::copy: m_error = true; m_errorMsg = "Passing style copy not allowed";
-		break; case passing_style::move: m_error = true; m_errorMsg = "Passing style move not allowed";
-		break; case passing_style::forward: m_error = true; m_errorMsg = "Passing style forward not allowed";
-		break; default:;
+		if (n.pass != passing_style::in) {
+			m_writeTargets.push_back(n.expr->position());
 		}
-
-		assert(n.declaration);
 	}
 
-	auto end(parameter_declaration_node const& n, int indent) -> void
+	auto start(postfix_expression_node const& n, int) -> void
 	{
-		m_parsingParam = false;
-		m_params.push_back(m_current);
-	}
+		auto root = n.expr->to_string();
 
-	auto start(parameter_declaration_list_node const&, int indent) -> void
-	{
-		//o << pre(indent) << "parameter-declaration-list\n";
-	}
+		auto is_call = false;
+		for (auto const& op : n.ops) {
+			is_call = is_call || op.op->type() == lexeme::LeftParen;
+		}
 
-	auto start(template_args_tag const&, int indent) -> void
-	{
-		if (m_parsingParam && m_parsingParamType) {
-			m_parsingParamTypeTemplateArgs = true;
+		if (auto p = find_param(root)) {
+			auto written = is_write_target(n.position())
+				|| std::find(m_impureCalls.begin(), m_impureCalls.end(), true) != m_impureCalls.end();
+
+			if (!n.ops.empty()
+				&& n.ops[0].op->type() == lexeme::Dot
+				&& n.ops[0].id_expr
+				&& (n.ops.size() == 1 || n.ops[1].op->type() != lexeme::LeftParen)
+				)
+			{
+				//  anything applied past the field other than member access or indexing may modify it
+				for (auto i = 1; i < std::ssize(n.ops); ++i) {
+					auto t = n.ops[i].op->type();
+					written = written || (t != lexeme::Dot && t != lexeme::LeftBracket);
+				}
+				record(*p, n.ops[0].id_expr->to_string(), written);
+			}
+			else {
+				p->m_whole = true;
+			}
 		}
-	}
-	auto end(template_args_tag const&, int indent) -> void
-	{
-		m_parsingParamTypeTemplateArgs = false;
-	}
 
+		m_impureCalls.push_back(is_call && std::find(m_pureRoots.begin(), m_pureRoots.end(), root) == m_pureRoots.end());
+	}
 
-	auto start(translation_unit_node const&, int indent) -> void
+	auto end(postfix_expression_node const&, int) -> void
 	{
-		//o << pre(indent) << "translation-unit\n";
+		m_impureCalls.pop_back();
 	}
 
-	auto start(auto const&, int indent) -> void
+	auto start(auto const&, int) -> void
 	{
-		//o << pre(indent) << "UNRECOGNIZED -- FIXME\n";
+		//  Ignore other node types
 	}
 
 	auto end(auto const&, int) -> void
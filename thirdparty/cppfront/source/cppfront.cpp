@@ -19,6 +19,12 @@
 #include <iostream>
 #include <cstdio>
 #include <optional>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <filesystem>
 
 namespace cpp2 {
 
@@ -143,6 +149,16 @@ static cmdline_processor::register_flag cmd_no_exceptions(
     []{ flag_no_exceptions = true; }
 );
 
+static auto flag_jobs = 1;
+static cmdline_processor::register_flag cmd_jobs(
+    9,
+    "jobs N",
+    "Translate up to N files concurrently (output order is unchanged)",
+    nullptr,
+    [](std::string const& n) { flag_jobs = std::max(1, atoi(n.c_str())); },
+    "j"
+);
+
 static auto flag_no_rtti = false;
 static cmdline_processor::register_flag cmd_no_rtti(
     4,
@@ -650,6 +666,18 @@ public:
     }
 
 
+    //-----------------------------------------------------------------------
+    //  Close: finish writing the output file, e.g. so it can be read back
+    //
+    auto close()
+        -> void
+    {
+        if (out_file.is_open()) {
+            out_file.close();
+        }
+    }
+
+
     //-----------------------------------------------------------------------
     //  Abandon: close and delete
     //
@@ -988,6 +1016,10 @@ struct function_prolog {
 
 class cppfront
 {
+    //  Declared first so it outlives the parse tree: every node of this
+    //  translation unit is released together when this goes away
+    cpp2::parse_tree_arena   arena;
+
     std::string              sourcefile;
     std::vector<error_entry> errors;
 
@@ -1360,7 +1392,7 @@ public:
                         )
                     {
                         //  Strip off the 2"
-                        auto h_include = line.text.substr(0, line.text.size()-2);
+                        auto h_include = std::string{ line.text.substr(0, line.text.size()-2) };
                         printer.print_cpp1( h_include + "\"", curr_lineno );
                         hpp_includes += h_include + "pp\"\n";
                     }
@@ -5978,7 +6010,13 @@ public:
     //-----------------------------------------------------------------------
     //  print_errors
     //
-    auto print_errors()
+    auto close_output()
+        -> void
+    {
+        printer.close();
+    }
+
+    auto print_errors(std::ostream& err = std::cerr)
         -> void
     {
         if (!errors.empty()) {
@@ -6007,19 +6045,19 @@ public:
                 || error != *prev
                 )
             {
-                error.print(std::cerr, strip_path(sourcefile));
+                error.print(err, strip_path(sourcefile));
             }
             prev = &error;
         }
 
         if (violates_lifetime_safety) {
-            std::cerr << "  ==> program violates lifetime safety guarantee - see previous errors\n";
+            err << "  ==> program violates lifetime safety guarantee - see previous errors\n";
         }
         if (violates_bounds_safety) {
-            std::cerr << "  ==> program violates bounds safety guarantee - see previous errors\n";
+            err << "  ==> program violates bounds safety guarantee - see previous errors\n";
         }
         if (violates_initialization_safety) {
-            std::cerr << "  ==> program violates initialization safety guarantee - see previous errors\n";
+            err << "  ==> program violates initialization safety guarantee - see previous errors\n";
         }
     }
 
@@ -6073,6 +6111,16 @@ public:
     {
         return source.has_cpp2();
     }
+
+
+    //-----------------------------------------------------------------------
+    //  get_meta_function_timings: pass through
+    //
+    auto get_meta_function_timings() const
+        -> auto const&
+    {
+        return parser.get_meta_function_timings();
+    }
 };
 
 }
@@ -6093,6 +6141,417 @@ static cmdline_processor::register_flag cmd_debug(
     []{ enable_debug_output_files = true; }
 );
 
+static auto flag_cache_dir = std::string{};
+static cmdline_processor::register_flag cmd_cache_dir(
+    9,
+    "cache directory",
+    "Reuse translations of unchanged files stored in 'directory'",
+    nullptr,
+    [](std::string const& dir) { flag_cache_dir = dir; }
+);
+
+
+//-----------------------------------------------------------------------
+//
+//  translation_cache: -cache. A successful translation is stored under a
+//  hash of the source file, the cppfront binary and every flag that can
+//  change the output. When all of those are unchanged, the Cpp1 output and
+//  the summary are written back without loading, lexing, parsing, running
+//  sema and metafunctions, or lowering.
+//
+//-----------------------------------------------------------------------
+//
+class translation_cache
+{
+    std::filesystem::path dir;
+    std::uint64_t         tool_hash = 0;
+
+    static auto hash_bytes(std::string_view bytes, std::uint64_t h = 14695981039346656037ull)
+        -> std::uint64_t
+    {
+        for (auto c : bytes) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    static auto read_file(std::filesystem::path const& path, std::string& text)
+        -> bool
+    {
+        auto in = std::ifstream(path, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return !in.bad();
+    }
+
+    auto entry_path(std::string const& key) const
+        -> std::filesystem::path
+    {
+        return dir / (key + ".cpp1cache");
+    }
+
+public:
+    translation_cache(
+        std::string const& dir_,
+        std::string const& binary_path
+    )
+        : dir{dir_}
+    {
+        //  Fall back to the build stamp if the binary can't be found from argv[0]
+        auto binary = std::string{};
+        if (!read_file(binary_path, binary) && !read_file(binary_path + ".exe", binary)) {
+            binary = __DATE__ " " __TIME__;
+        }
+        tool_hash = hash_bytes(binary);
+
+        auto flags = std::string{};
+        flags += flag_clean_cpp1          ? '1' : '0';
+        flags += flag_cpp2_only           ? '1' : '0';
+        flags += flag_safe_null_pointers  ? '1' : '0';
+        flags += flag_safe_subscripts     ? '1' : '0';
+        flags += flag_safe_comparisons    ? '1' : '0';
+        flags += flag_use_source_location ? '1' : '0';
+        flags += flag_verbose             ? '1' : '0';
+        flags += flag_no_exceptions       ? '1' : '0';
+        flags += flag_no_rtti             ? '1' : '0';
+        flags += flag_cpp1_filename;
+        tool_hash = hash_bytes(flags, tool_hash);
+
+        auto ec = std::error_code{};
+        std::filesystem::create_directories(dir, ec);
+    }
+
+    //  The key also covers the filename as given, since it appears in #line directives
+    auto key_for(std::string const& sourcefile) const
+        -> std::string
+    {
+        auto source = std::string{};
+        if (!read_file(sourcefile, source)) {
+            return {};
+        }
+        auto h = hash_bytes(sourcefile, tool_hash);
+        h = hash_bytes(std::string_view("\0", 1), h);
+        h = hash_bytes(source, h);
+
+        char key[17];
+        std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(h));
+        return key;
+    }
+
+    //  Writes the cached output to cpp1_filename and returns the cached summary
+    auto restore(
+        std::string const& key,
+        std::string const& cpp1_filename,
+        std::string&       summary
+    ) const
+        -> bool
+    {
+        auto entry = std::string{};
+        if (!read_file(entry_path(key), entry)) {
+            return false;
+        }
+
+        //  An entry is the summary length on the first line, the summary, then the output
+        auto newline = entry.find('\n');
+        if (newline == entry.npos) {
+            return false;
+        }
+        auto summary_len = std::strtoull(entry.c_str(), nullptr, 10);
+        if (summary_len > entry.size() - newline - 1) {
+            return false;
+        }
+        summary = entry.substr(newline + 1, summary_len);
+
+        auto out = std::ofstream(cpp1_filename, std::ios::binary);
+        out.write(entry.data() + newline + 1 + summary_len, std::ssize(entry) - (newline + 1 + summary_len));
+        return out.good();
+    }
+
+    auto store(
+        std::string const& key,
+        std::string const& cpp1_filename,
+        std::string const& summary
+    ) const
+        -> void
+    {
+        auto cpp1 = std::string{};
+        if (!read_file(cpp1_filename, cpp1)) {
+            return;
+        }
+
+        //  Write then rename, so concurrent translations never see a partial entry. The
+        //  temp name is unique per process and thread, since make -j can run several
+        //  cppfronts on the same cache
+#ifdef _WIN32
+        auto const pid = static_cast<unsigned long long>(GetCurrentProcessId());
+#else
+        auto const pid = static_cast<unsigned long long>(getpid());
+#endif
+        auto tmp = entry_path(key);
+        tmp += "." + std::to_string(pid) + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        {
+            auto out = std::ofstream(tmp, std::ios::binary);
+            out << summary.size() << '\n' << summary << cpp1;
+            if (!out.good()) {
+                return;
+            }
+        }
+        auto ec = std::error_code{};
+        std::filesystem::rename(tmp, entry_path(key), ec);
+        if (ec) {
+            std::filesystem::remove(tmp, ec);
+        }
+    }
+};
+
+static auto cache = std::optional<translation_cache>{};
+
+
+//-----------------------------------------------------------------------
+//
+//  print_meta_function_timings: how long each type's metafunctions took,
+//  slowest type first, for -verbose
+//
+//-----------------------------------------------------------------------
+//
+auto print_meta_function_timings(
+    std::vector<parser::meta_function_timing> const& timings,
+    std::ostream&                                    out
+)
+    -> void
+{
+    if (timings.empty()) {
+        return;
+    }
+
+    //  Total per type, keeping the types in the order they were first seen
+    struct type_timing {
+        std::string_view         type_name;
+        std::string              meta_function_names;
+        std::chrono::nanoseconds duration = {};
+    };
+    auto types = std::vector<type_timing>{};
+    auto total = std::chrono::nanoseconds{};
+    for (auto const& t : timings)
+    {
+        auto it = std::find_if(types.begin(), types.end(), [&](auto const& x){ return x.type_name == t.type_name; });
+        if (it == types.end()) {
+            types.push_back({ t.type_name, {} });
+            it = std::prev(types.end());
+        }
+        if (!it->meta_function_names.empty()) {
+            it->meta_function_names += " ";
+        }
+        it->meta_function_names += "@" + t.meta_function_name;
+        it->duration += t.duration;
+        total += t.duration;
+    }
+    std::stable_sort(types.begin(), types.end(), [](auto const& a, auto const& b){ return a.duration > b.duration; });
+
+    auto as_ms = [](std::chrono::nanoseconds d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    auto old_precision = out.precision();
+    out << "   Metafunctions: " << std::fixed << std::setprecision(3) << as_ms(total) << " ms for " << types.size() << " types\n";
+    for (auto const& t : types) {
+        out << "      " << std::setw(9) << as_ms(t.duration) << " ms  " << t.type_name << "  " << t.meta_function_names << "\n";
+    }
+    out << std::defaultfloat << std::setprecision(old_precision);
+}
+
+
+//-----------------------------------------------------------------------
+//
+//  reset_translation_state: clear the per-thread state lexing, parsing
+//  and sema keep outside the cppfront object. It refers to the previous
+//  file's tokens, so a file must not see what the one translated before
+//  it on the same thread left behind
+//
+//-----------------------------------------------------------------------
+//
+auto reset_translation_state()
+    -> void
+{
+    generated_text.clear();
+    generated_lines.clear();
+    multiline_raw_strings.clear();
+    generated_lexers.clear();
+    violates_lifetime_safety = false;
+    expression_node::current_expressions.clear();
+    expression_statement_node::current_expression_statements.clear();
+    definite_initializations.clear();
+    definite_last_uses.clear();
+}
+
+
+//-----------------------------------------------------------------------
+//
+//  translate_file: load, lex, parse, sema and lower one file, reporting
+//  the result and any errors to the given streams
+//
+//-----------------------------------------------------------------------
+//
+auto translate_file(
+    std::string const& filename,
+    std::ostream&      out,
+    std::ostream&      err
+)
+    -> bool
+{
+    out << filename << "...";
+
+    //  Same naming as cppfront::lower_to_cpp1
+    auto cpp1_filename = flag_cpp1_filename.empty() ? filename.substr(0, std::ssize(filename) - 1) : flag_cpp1_filename;
+    auto cache_key = std::string{};
+    if (
+        cache
+        && cpp1_filename != "stdout"
+        && !enable_debug_output_files
+        && !(cpp1_filename.ends_with(".h") && flag_cpp2_only)  // also writes a .hpp
+        )
+    {
+        cache_key = cache->key_for(filename);
+        auto summary = std::string{};
+        if (
+            !cache_key.empty()
+            && cache->restore(cache_key, cpp1_filename, summary)
+            )
+        {
+            out << summary;
+            return true;
+        }
+    }
+
+    //  Load + lex + parse + sema
+    reset_translation_state();
+    cppfront c(filename);
+
+    //c.debug_print();
+
+    //  Generate Cpp1 (this may catch additional late errors)
+    auto count = c.lower_to_cpp1();
+
+    auto ok = c.had_no_errors();
+
+    //  If there were no errors, say so and generate Cpp1
+    if (ok)
+    {
+        auto summary = std::ostringstream{};
+        if (!c.has_cpp1()) {
+            summary << " ok (all Cpp2, passes safety checks)\n";
+        }
+        else if (c.has_cpp2()) {
+            summary << " ok (mixed Cpp1/Cpp2, Cpp2 code passes safety checks)\n";
+        }
+        else {
+            summary << " ok (all Cpp1)\n";
+        }
+
+        if (flag_verbose) {
+            summary << "   Cpp1: " << count.cpp1_lines << " lines\n";
+            summary << "   Cpp2: " << count.cpp2_lines << " lines";
+            if (count.cpp1_lines + count.cpp2_lines > 0) {
+                summary << " (" << 100 * count.cpp2_lines / (count.cpp1_lines + count.cpp2_lines) << "%)";
+            }
+            summary << "\n";
+        }
+
+        out << summary.str();
+
+        //  Timings are per run, so they're printed but not cached with the summary
+        if (flag_verbose) {
+            print_meta_function_timings(c.get_meta_function_timings(), out);
+        }
+
+        summary << "\n";
+        out << "\n";
+
+        if (!cache_key.empty()) {
+            c.close_output();
+            cache->store(cache_key, cpp1_filename, summary.str());
+        }
+    }
+    //  Otherwise, print the errors
+    else
+    {
+        err << "\n";
+        c.print_errors(err);
+        err << "\n";
+    }
+
+    //  And, if requested, the debug information
+    if (enable_debug_output_files) {
+        c.debug_print();
+    }
+
+    return ok;
+}
+
+
+//-----------------------------------------------------------------------
+//
+//  translate_files_in_parallel: -jobs mode. Each file is translated on
+//  one worker thread into its own buffers, and the buffers are written
+//  out in command line order as soon as each file and all files before
+//  it are done, so the output is the same as a sequential run
+//
+//-----------------------------------------------------------------------
+//
+auto translate_files_in_parallel(
+    std::vector<std::string> const& filenames,
+    int                             num_jobs
+)
+    -> int
+{
+    struct result {
+        std::ostringstream out;
+        std::ostringstream err;
+        bool               ok   = false;
+        bool               done = false;
+    };
+    auto results = std::vector<result>(filenames.size());
+
+    auto next_file = std::atomic<size_t>{0};
+    auto results_mutex = std::mutex{};
+    auto result_done = std::condition_variable{};
+
+    auto workers = std::vector<std::thread>{};
+    num_jobs = std::min(num_jobs, __as<int>(std::ssize(filenames)));
+    for (auto i = 0; i < num_jobs; ++i) {
+        workers.emplace_back([&] {
+            for (auto f = next_file++; f < filenames.size(); f = next_file++) {
+                auto ok = translate_file(filenames[f], results[f].out, results[f].err);
+
+                auto lock = std::lock_guard{results_mutex};
+                results[f].ok = ok;
+                results[f].done = true;
+                result_done.notify_all();
+            }
+        });
+    }
+
+    int exit_status = EXIT_SUCCESS;
+    auto& out = flag_cpp1_filename != "stdout" ? std::cout : std::cerr;
+    for (auto& r : results) {
+        {
+            auto lock = std::unique_lock{results_mutex};
+            result_done.wait(lock, [&]{ return r.done; });
+        }
+        out << r.out.str() << std::flush;
+        std::cerr << r.err.str();
+        if (!r.ok) {
+            exit_status = EXIT_FAILURE;
+        }
+    }
+
+    for (auto& w : workers) {
+        w.join();
+    }
+    return exit_status;
+}
+
+
 auto main(
     int   argc,
     char* argv[]
@@ -6111,59 +6570,29 @@ auto main(
         return EXIT_FAILURE;
     }
 
+    if (!flag_cache_dir.empty()) {
+        cache.emplace(flag_cache_dir, argv[0]);
+    }
+
+    //  Translate concurrently only when each file has its own output
+    if (flag_jobs > 1 && flag_cpp1_filename.empty() && std::ssize(cmdline.arguments()) > 1)
+    {
+        auto filenames = std::vector<std::string>{};
+        for (auto const& arg : cmdline.arguments()) {
+            filenames.push_back(arg.text);
+        }
+        return translate_files_in_parallel(filenames, flag_jobs);
+    }
+
     //  For each Cpp2 source file
     int exit_status = EXIT_SUCCESS;
     for (auto const& arg : cmdline.arguments())
     {
         auto& out = flag_cpp1_filename != "stdout" ? std::cout : std::cerr;
 
-        out << arg.text << "...";
-
-        //  Load + lex + parse + sema
-        cppfront c(arg.text);
-
-        //c.debug_print();
-
-        //  Generate Cpp1 (this may catch additional late errors)
-        auto count = c.lower_to_cpp1();
-
-        //  If there were no errors, say so and generate Cpp1
-        if (c.had_no_errors())
-        {
-            if (!c.has_cpp1()) {
-                out << " ok (all Cpp2, passes safety checks)\n";
-            }
-            else if (c.has_cpp2()) {
-                out << " ok (mixed Cpp1/Cpp2, Cpp2 code passes safety checks)\n";
-            }
-            else {
-                out << " ok (all Cpp1)\n";
-            }
-
-            if (flag_verbose) {
-                out << "   Cpp1: " << count.cpp1_lines << " lines\n";
-                out << "   Cpp2: " << count.cpp2_lines << " lines";
-                if (count.cpp1_lines + count.cpp2_lines > 0) {
-                    out << " (" << 100 * count.cpp2_lines / (count.cpp1_lines + count.cpp2_lines) << "%)";
-                }
-                out << "\n";
-            }
-
-            out << "\n";
-        }
-        //  Otherwise, print the errors
-        else
-        {
-            std::cerr << "\n";
-            c.print_errors();
-            std::cerr << "\n";
+        if (!translate_file(arg.text, out, std::cerr)) {
             exit_status = EXIT_FAILURE;
         }
-
-        //  And, if requested, the debug information
-        if (enable_debug_output_files) {
-            c.debug_print();
-        }
     }
     return exit_status;
 }
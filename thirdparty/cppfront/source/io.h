@@ -24,6 +24,21 @@
 #include <iterator>
 #include <cctype>
 
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
 
 namespace cpp2 {
 
@@ -35,7 +50,7 @@ namespace cpp2 {
 //  p       predicate to apply
 //
 auto move_next(
-    std::string const& line,
+    std::string_view   line,
     int&               i,
     auto               p
 )
@@ -61,7 +76,7 @@ auto move_next(
 //
 //  line    current line being processed
 //
-auto peek_first_non_whitespace(std::string const& line)
+auto peek_first_non_whitespace(std::string_view line)
     -> char
 {
     auto i = 0;
@@ -87,7 +102,7 @@ struct is_preprocessor_ret {
     bool has_continuation;
 };
 auto is_preprocessor(
-    std::string const& line,
+    std::string_view   line,
     bool               first_line
 )
     -> is_preprocessor_ret
@@ -102,7 +117,7 @@ auto is_preprocessor(
     }
 
     //  return true iff last character is a \ continuation
-    return { true, line.back() == '\\' };
+    return { true, !line.empty() && line.back() == '\\' };
 }
 
 
@@ -111,7 +126,7 @@ auto is_preprocessor(
 //
 //  line    current line being processed
 //
-auto starts_with_import(std::string const& line)
+auto starts_with_import(std::string_view line)
     -> bool
 {
     auto i = 0;
@@ -124,12 +139,14 @@ auto starts_with_import(std::string const& line)
     static constexpr auto import_keyword = std::string_view{"import"};
 
     // the first token must begin with 'import'
-    if (!std::string_view(line).substr(i).starts_with(import_keyword)) {
+    if (!line.substr(i).starts_with(import_keyword)) {
         return false;
     }
 
     // and not be immediately followed by an _identifier-continue_
-    return !is_identifier_continue(line[i + import_keyword.size()]);
+    return
+        i + std::ssize(import_keyword) == std::ssize(line)
+        || !is_identifier_continue(line[i + import_keyword.size()]);
 }
 
 
@@ -138,7 +155,7 @@ auto starts_with_import(std::string const& line)
 //
 //  line    current line being processed
 //
-auto starts_with_whitespace_slash_slash(std::string const& line)
+auto starts_with_whitespace_slash_slash(std::string_view line)
     -> bool
 {
     auto i = 0;
@@ -161,7 +178,7 @@ auto starts_with_whitespace_slash_slash(std::string const& line)
 //
 //  line    current line being processed
 //
-auto starts_with_whitespace_slash_star_and_no_star_slash(std::string const& line)
+auto starts_with_whitespace_slash_star_and_no_star_slash(std::string_view line)
     -> bool
 {
     auto i = 0;
@@ -278,7 +295,7 @@ auto starts_with_operator(std::string_view s)
 //
 //  line    current line being processed
 //
-auto starts_with_identifier_colon(std::string const& line)
+auto starts_with_identifier_colon(std::string_view line)
     -> bool
 {
     auto i = 0;
@@ -488,7 +505,7 @@ enum class preprocessor_conditional {
     none = 0, pre_if, pre_else, pre_endif
 };
 auto starts_with_preprocessor_if_else_endif(
-    std::string const& line
+    std::string_view   line
 )
     -> preprocessor_conditional
 {
@@ -538,7 +555,7 @@ struct process_line_ret {
     bool all_rawstring_line;
 };
 auto process_cpp_line(
-    std::string const&  line,
+    std::string_view    line,
     bool&               in_comment,
     bool&               in_string_literal,
     bool&               in_raw_string_literal,
@@ -618,7 +635,7 @@ auto process_cpp_line(
                                 paren_pos != std::string::npos
                                 )
                             {
-                                raw_string_closing_seq = ")"+line.substr(i, paren_pos-i)+"\"";
+                                raw_string_closing_seq = ")"+std::string(line.substr(i, paren_pos-i))+"\"";
                                 in_raw_string_literal = true;
                             }
                         }
@@ -691,7 +708,7 @@ auto process_cpp_line(
 //  Returns:    whether additional lines should be inspected
 //
 auto process_cpp2_line(
-    std::string const&        line,
+    std::string_view          line,
     bool&                     in_comment,
     braces_tracker&           braces,
     lineno_t                  lineno,
@@ -762,6 +779,144 @@ auto process_cpp2_line(
 }
 
 
+//-----------------------------------------------------------------------
+//
+//  mapped_file: A read-only view of a whole file's bytes
+//
+//  The file is memory-mapped where the platform allows it, so that
+//  source lines can refer directly into it instead of each being copied
+//  into its own string. Anything that can't be mapped (an empty file,
+//  a pipe, a failed mapping) is read into one owned buffer instead.
+//
+//-----------------------------------------------------------------------
+//
+class mapped_file
+{
+    void const*   base = nullptr;
+    std::size_t   size = 0;
+    std::string   contents;     // used only when the file isn't mapped
+#ifdef _WIN32
+    HANDLE        mapping = nullptr;
+#endif
+
+    auto map(std::string const& filename)
+        -> void
+    {
+#ifdef _WIN32
+        auto file = CreateFileA(
+            filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+        );
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        auto file_size = LARGE_INTEGER{};
+        if (
+            GetFileSizeEx(file, &file_size)
+            && file_size.QuadPart > 0
+            )
+        {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (base) {
+                    size = static_cast<std::size_t>(file_size.QuadPart);
+                }
+                else {
+                    CloseHandle(mapping);
+                    mapping = nullptr;
+                }
+            }
+        }
+        CloseHandle(file);  // the mapping keeps the file open
+#else
+        auto fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (
+            ::fstat(fd, &st) == 0
+            && S_ISREG(st.st_mode)
+            && st.st_size > 0
+            )
+        {
+            auto p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                base = p;
+                size = static_cast<std::size_t>(st.st_size);
+            }
+        }
+        ::close(fd);    // the mapping keeps the file open
+#endif
+    }
+
+public:
+    mapped_file() = default;
+
+    ~mapped_file()
+    {
+#ifdef _WIN32
+        if (base) {
+            UnmapViewOfFile(base);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+#else
+        if (base) {
+            ::munmap(const_cast<void*>(base), size);
+        }
+#endif
+    }
+
+    //-----------------------------------------------------------------------
+    //  open: Map 'filename', or read it whole if it can't be mapped
+    //
+    //  Returns false if the file can't be opened at all
+    //
+    auto open(std::string const& filename)
+        -> bool
+    {
+        assert (!base && contents.empty() && "mapped_file can only be opened once");
+
+        map(filename);
+        if (base) {
+            return true;
+        }
+
+        std::ifstream in{ filename, std::ios::binary };
+        if (!in.is_open()) {
+            return false;
+        }
+        contents.assign(
+            std::istreambuf_iterator<char>(in),
+            std::istreambuf_iterator<char>()
+        );
+        return true;
+    }
+
+    //-----------------------------------------------------------------------
+    //  text: The file's bytes, valid for the lifetime of this object
+    //
+    auto text() const
+        -> std::string_view
+    {
+        if (base) {
+            return { static_cast<char const*>(base), size };
+        }
+        return contents;
+    }
+
+    //  No copying
+    //
+    mapped_file(mapped_file const&)            = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+    mapped_file(mapped_file&&)                 = delete;
+    mapped_file& operator=(mapped_file&&)      = delete;
+};
+
+
 //-----------------------------------------------------------------------
 //
 //  source: Represents a program source file
@@ -775,10 +930,7 @@ class source
     bool                      cpp1_found = false;
     bool                      cpp2_found = false;
 
-    static const int max_line_len = 90'000;
-        //  do not reduce this - I encountered an 80,556-char
-        //  line in real world code during testing
-    char buf[max_line_len];
+    mapped_file               file;     // the lines' text refers into this
 
 public:
     //-----------------------------------------------------------------------
@@ -791,7 +943,6 @@ public:
     )
         : errors{ errors_ }
         , lines( 1 )        // extra blank to avoid off-by-one everywhere
-        , buf{0}
     {
     }
 
@@ -820,16 +971,36 @@ public:
     //  filename                the source file to be loaded
     //  source                  program textual representation
     //
+    //  The lines are views into the mapped file, which this source owns,
+    //  so they are valid for as long as this source is
+    //
     auto load(
         std::string const&  filename
     )
         -> bool
     {
-        std::ifstream in{ filename };
-        if (!in.is_open()) {
+        if (!file.open(filename)) {
             return false;
         }
 
+        //  Split off the next line, without its line break
+        //  (a \r\n line break is treated like \n, as a text-mode stream would)
+        auto remaining = file.text();
+        auto line      = std::string_view{};
+        auto next_line = [&]() -> bool
+        {
+            if (remaining.empty()) {
+                return false;
+            }
+            auto eol = remaining.find('\n');
+            line = remaining.substr(0, eol);
+            remaining.remove_prefix(eol == remaining.npos ? remaining.size() : eol+1);
+            if (line.ends_with('\r')) {
+                line.remove_suffix(1);
+            }
+            return true;
+        };
+
         auto in_comment            = false;
         auto in_string_literal     = false;
         auto in_raw_string_literal = false;
@@ -838,7 +1009,7 @@ public:
         auto braces = braces_tracker(errors);
 
         auto add_preprocessor_line = [&] {
-            lines.push_back({ &buf[0], source_line::category::preprocessor });
+            lines.push_back({ line, source_line::category::preprocessor });
             if (auto pre = starts_with_preprocessor_if_else_endif(lines.back().text);
                 pre != preprocessor_conditional::none
                 )
@@ -856,11 +1027,11 @@ public:
             }
         };
 
-        while (in.getline(&buf[0], max_line_len)) {
+        while (next_line()) {
 
             //  Handle preprocessor source separately, they're outside the language
             //
-            if (auto pre = is_preprocessor(buf, true);
+            if (auto pre = is_preprocessor(line, true);
                 pre.is_preprocessor
                 && !in_comment
                 && !in_raw_string_literal
@@ -870,17 +1041,17 @@ public:
                 add_preprocessor_line();
                 while (
                     pre.has_continuation
-                    && in.getline(&buf[0], max_line_len)
+                    && next_line()
                     )
                 {
                     add_preprocessor_line();
-                    pre = is_preprocessor(buf, false);
+                    pre = is_preprocessor(line, false);
                 }
             }
 
             else
             {
-                lines.push_back({ &buf[0], source_line::category::cpp1 });
+                lines.push_back({ line, source_line::category::cpp1 });
 
                 //  Switch to cpp2 mode if we're not in a comment, not inside nested { },
                 //  and the line starts with "nonwhitespace :" but not "::"
@@ -916,10 +1087,10 @@ public:
                             std::ssize(lines)-1,
                             errors
                         )
-                        && in.getline(&buf[0], max_line_len)
+                        && next_line()
                         )
                     {
-                        lines.push_back({ &buf[0], source_line::category::cpp2 });
+                        lines.push_back({ line, source_line::category::cpp2 });
                     }
                 }
 
@@ -958,31 +1129,6 @@ public:
             }
         }
 
-        //  Because I encountered very long lines in real-world code during testing
-        //
-        if (in.gcount() >= max_line_len-1)
-        {
-            errors.emplace_back(
-                source_position(lineno_t(std::ssize(lines)), 0),
-                std::string("source line too long - length must be less than ")
-                    + std::to_string(max_line_len)
-            );
-            return false;
-        }
-
-        //  This shouldn't be possible, so check it anyway
-        //
-        if (!in.eof())
-        {
-            errors.emplace_back(
-                source_position(lineno_t(std::ssize(lines)), 0),
-                std::string("unexpected error reading source lines - did not reach EOF"),
-                false,
-                true    // a noisy fallback error
-            );
-            return false;
-        }
-
         braces.found_eof( source_position(lineno_t(std::ssize(lines)), 0) );
 
         return true;
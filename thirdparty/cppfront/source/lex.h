@@ -292,6 +292,12 @@ public:
         pos.colno += offset;
     }
 
+    auto position_line_shift( lineno_t offset )
+        -> void
+    {
+        pos.lineno += offset;
+    }
+
     auto position() const -> source_position { return pos;       }
 
     auto length  () const -> int             { return sv.size(); }
@@ -534,14 +540,17 @@ auto expand_raw_string_literal(
 //  A stable place to store additional text for source tokens that are merged
 //  into a whitespace-containing token (to merge the Cpp1 multi-token keywords)
 //  -- this isn't about tokens generated later, that's tokens::generated_tokens
-static auto generated_text  = std::deque<std::string>{};
-static auto generated_lines = std::deque<std::vector<source_line>>{};
+//
+//  These are per thread, so -jobs can translate several files at once; a file is
+//  always translated start to finish on one thread
+static thread_local auto generated_text  = std::deque<std::string>{};
+static thread_local auto generated_lines = std::deque<std::vector<source_line>>{};
 
 
-static auto multiline_raw_strings = std::deque<multiline_raw_string>{};
+static thread_local auto multiline_raw_strings = std::deque<multiline_raw_string>{};
 
 auto lex_line(
-    std::string&               mutable_line,
+    std::string_view&          mutable_line,
     int const                  lineno,
     bool&                      in_comment,
     std::string&               current_comment,
@@ -555,6 +564,16 @@ auto lex_line(
 {
     auto const& line = mutable_line;    // most accesses will be const, so give that the nice name
 
+    //  The line is a view of text owned elsewhere, so to rewrite it (to expand
+    //  interpolations) put the rewritten copy in stable storage and view that
+    auto replace_in_line = [&](colno_t pos, colno_t count, std::string_view replacement)
+    {
+        auto rewritten = std::string{line};
+        rewritten.replace( pos, count, replacement );
+        generated_text.push_back( std::move(rewritten) );
+        mutable_line = generated_text.back();
+    };
+
     auto original_size = std::ssize(tokens);
 
     auto i = colno_t{0};
@@ -1019,7 +1038,7 @@ auto lex_line(
     ) -> bool {
         auto parts = expand_raw_string_literal(opening_seq, closing_seq, closing_strategy, part, errors, source_position(lineno, pos_to_replace + 1));
         auto new_part = parts.generate();
-        mutable_line.replace( pos_to_replace, size_to_replace, new_part );
+        replace_in_line( pos_to_replace, size_to_replace, new_part );
         i += std::ssize(new_part)-1;
 
         if (parts.is_expanded()) {
@@ -1088,8 +1107,13 @@ auto lex_line(
                     in_comment = false;
                     ++i;
                 }
-            break;default:
-                current_comment += line[i];
+            break;default: {
+                //  Nothing but */ can end the comment, so take everything
+                //  up to the next * in one step
+                auto star = unsafe_narrow<colno_t>( std::min(line.find('*', i), line.size()) );
+                current_comment += line.substr(i, star - i);
+                i = star - 1;
+            }
             }
         }
         else if (raw_string_multiline) {
@@ -1136,6 +1160,12 @@ auto lex_line(
         //  Otherwise, we will be at the start of a token, a comment, or whitespace
         //
         else {
+            //  Skip a run of whitespace in one step, it can't start anything
+            if (isspace(line[i])) {
+                i = unsafe_narrow<colno_t>( scan_run<whitespace_chars>(line, i) ) - 1;
+                continue;
+            }
+
             //G token:
             //G     identifier
             //G     keyword
@@ -1325,8 +1355,8 @@ auto lex_line(
                     auto seq_pos = i + 3;
                         
                     if (auto paren_pos = line.find("(", seq_pos); paren_pos != std::string::npos) {
-                        auto opening_seq = line.substr(i, paren_pos - i + 1);
-                        auto closing_seq = ")"+line.substr(seq_pos, paren_pos-seq_pos)+"\"";
+                        auto opening_seq = std::string{ line.substr(i, paren_pos - i + 1) };
+                        auto closing_seq = ")"+std::string(line.substr(seq_pos, paren_pos-seq_pos))+"\"";
 
                         if (auto closing_pos = line.find(closing_seq, paren_pos+1); closing_pos != line.npos) {
                             if (interpolate_raw_string(
@@ -1351,7 +1381,7 @@ auto lex_line(
                                     opening_seq,
                                     closing_seq,
                                     string_parts::on_the_beginning,
-                                    std::string_view(&line[paren_pos+1], std::ssize(line)-(paren_pos+1)), i, std::ssize(line)-i)
+                                    line.substr(paren_pos+1), i, std::ssize(line)-i)
                             ) {
                                 continue;
                             }
@@ -1462,8 +1492,7 @@ auto lex_line(
                 //G      own unit test rather than inline everything here
                 //G
                 else if (is_digit(line[i])) {
-                    auto j = 1;
-                    while (is_separator_or(is_digit,peek(j))) { ++j; }
+                    auto j = unsafe_narrow<int>( scan_run<digit_or_separator_chars>(line, i+1) ) - i;
                     if (
                         (peek(j) != '.' || !is_digit(peek(j+1)))
                         && peek(j) != 'f'
@@ -1540,8 +1569,8 @@ auto lex_line(
                         auto seq_pos = i + j;
                             
                         if (auto paren_pos = line.find("(", seq_pos); paren_pos != std::string::npos) {
-                            auto opening_seq = line.substr(i, paren_pos - i + 1);
-                            auto closing_seq = ")"+line.substr(seq_pos, paren_pos-seq_pos)+"\"";
+                            auto opening_seq = std::string{ line.substr(i, paren_pos - i + 1) };
+                            auto closing_seq = ")"+std::string(line.substr(seq_pos, paren_pos-seq_pos))+"\"";
 
                             if (auto closing_pos = line.find(closing_seq, paren_pos+1); closing_pos != line.npos) {
                                 store(closing_pos+std::ssize(closing_seq)-i, lexeme::StringLiteral);
@@ -1595,7 +1624,7 @@ auto lex_line(
                                 );
                                 return {};
                             }
-                            mutable_line.replace( i, j+1, s );
+                            replace_in_line( i, j+1, s );
 
                             reset_processing_of_the_line();
                         }
@@ -1851,6 +1880,36 @@ public:
     }
 
 
+    //-----------------------------------------------------------------------
+    //  restart_line_numbers: Renumber generated code that was lexed as
+    //  several fragments at once, so that each fragment's lines are
+    //  numbered as if it had been lexed on its own
+    //
+    //  fragment_starts     the line (within the section) at which each
+    //                      fragment starts, ascending, beginning with 0
+    //
+    auto restart_line_numbers(std::vector<lineno_t> const& fragment_starts)
+        -> void
+    {
+        assert (!fragment_starts.empty() && fragment_starts.front() == 0);
+        for (auto& [lineno, entry] : grammar_map)
+        {
+            auto fragment = fragment_starts.begin();
+            for (auto& t : entry)
+            {
+                while (
+                    std::next(fragment) != fragment_starts.end()
+                    && *std::next(fragment) <= t.position().lineno - lineno
+                    )
+                {
+                    ++fragment;
+                }
+                t.position_line_shift( -*fragment );
+            }
+        }
+    }
+
+
     //-----------------------------------------------------------------------
     //  get_map: Access the token map
     //
@@ -1938,7 +1997,7 @@ public:
 
 };
 
-static auto generated_lexers = std::deque<tokens>{};
+static thread_local auto generated_lexers = std::deque<tokens>{};
 
 }
 
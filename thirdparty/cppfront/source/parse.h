@@ -22,11 +22,13 @@
 #include <memory>
 #include <variant>
 #include <iostream>
+#include <chrono>
+#include <memory_resource>
 
 
 namespace cpp2 {
 
-auto violates_lifetime_safety = false;
+thread_local auto violates_lifetime_safety = false;
 
 //-----------------------------------------------------------------------
 //  Operator categorization
@@ -99,6 +101,81 @@ auto is_assignment_operator(lexeme l)
 }
 
 
+//-----------------------------------------------------------------------
+//
+//  parse_tree_arena: Bump allocation for parse tree nodes
+//
+//  A translation unit creates a great many small nodes that all live
+//  until its parse tree is discarded, so while an arena is active the
+//  nodes are carved out of large blocks that are all released together
+//  when the arena goes away. Deleting one node (e.g., one discarded while
+//  parsing) still runs its destructor, but leaves its memory in the block.
+//
+//  The active arena is per thread, since -jobs parses several translation
+//  units at once each on its own thread.
+//
+//-----------------------------------------------------------------------
+//
+class parse_tree_arena
+{
+    std::pmr::monotonic_buffer_resource resource;
+    parse_tree_arena*                   previous;
+
+    static inline thread_local parse_tree_arena* current = nullptr;
+
+public:
+    parse_tree_arena()
+        : resource{ 64 * 1024 }
+        , previous{ current }
+    {
+        current = this;
+    }
+
+    ~parse_tree_arena()
+    {
+        assert (current == this && "parse_tree_arenas must be destroyed in reverse order");
+        current = previous;
+    }
+
+    static auto allocate(std::size_t size)
+        -> void*
+    {
+        if (!current) {
+            //  Nodes made with no arena active (cppfront always has one)
+            //  live until the thread exits
+            static thread_local auto fallback = std::pmr::monotonic_buffer_resource{};
+            return fallback.allocate(size, alignof(std::max_align_t));
+        }
+        return current->resource.allocate(size, alignof(std::max_align_t));
+    }
+
+    //  No copying
+    //
+    parse_tree_arena(parse_tree_arena const&)            = delete;
+    parse_tree_arena& operator=(parse_tree_arena const&) = delete;
+    parse_tree_arena(parse_tree_arena&&)                 = delete;
+    parse_tree_arena& operator=(parse_tree_arena&&)      = delete;
+};
+
+//  Base for parse tree nodes, so that make_unique and unique_ptr's
+//  delete go through the current parse_tree_arena
+//
+struct parse_tree_allocated
+{
+    static auto operator new(std::size_t size)
+        -> void*
+    {
+        return parse_tree_arena::allocate(size);
+    }
+
+    static auto operator delete(void*) noexcept
+        -> void
+    {
+        //  Released in bulk with the arena
+    }
+};
+
+
 //-----------------------------------------------------------------------
 //
 //  Parse tree node types
@@ -131,7 +208,7 @@ struct inspect_expression_node;
 struct literal_node;
 
 
-struct primary_expression_node
+struct primary_expression_node : parse_tree_allocated
 {
     enum active { empty=0, identifier, expression_list, id_expression, declaration, inspect, literal };
     std::variant<
@@ -175,7 +252,7 @@ struct primary_expression_node
 };
 
 
-struct literal_node {
+struct literal_node : parse_tree_allocated {
     token const* literal             = {};
     token const* user_defined_suffix = {};
 
@@ -222,7 +299,7 @@ struct literal_node {
 
 struct postfix_expression_node;
 
-struct prefix_expression_node
+struct prefix_expression_node : parse_tree_allocated
 {
     std::vector<token const*> ops;
     std::unique_ptr<postfix_expression_node> expr;
@@ -270,7 +347,7 @@ template<
     String   Name,
     typename Term
 >
-struct binary_expression_node
+struct binary_expression_node : parse_tree_allocated
 {
     std::unique_ptr<Term>  expr;
     expression_node const* my_expression = {};
@@ -454,9 +531,9 @@ struct assignment_expression_lhs_rhs {
 
 struct expression_statement_node;
 
-struct expression_node
+struct expression_node : parse_tree_allocated
 {
-    static inline std::vector<expression_node*> current_expressions = {};
+    static inline thread_local std::vector<expression_node*> current_expressions = {};
 
     std::unique_ptr<assignment_expression_node> expr;
     int num_subexpressions = 0;
@@ -592,7 +669,7 @@ auto to_string_view(passing_style pass) -> std::string_view {
 }
 
 
-struct expression_list_node
+struct expression_list_node : parse_tree_allocated
 {
     token const* open_paren  = {};
     token const* close_paren = {};
@@ -665,9 +742,9 @@ auto primary_expression_node::is_literal() const
 }
 
 
-struct expression_statement_node
+struct expression_statement_node : parse_tree_allocated
 {
-    static inline std::vector<expression_statement_node*> current_expression_statements = {};
+    static inline thread_local std::vector<expression_statement_node*> current_expression_statements = {};
 
     std::unique_ptr<expression_node> expr;
     bool has_semicolon = false;
@@ -750,7 +827,7 @@ struct capture_group {
 };
 
 
-struct postfix_expression_node
+struct postfix_expression_node : parse_tree_allocated
 {
     std::unique_ptr<primary_expression_node> expr;
 
@@ -954,7 +1031,7 @@ struct type_id_node;
 struct template_args_tag { };
 
 
-struct unqualified_id_node
+struct unqualified_id_node : parse_tree_allocated
 {
     token const* identifier      = {};  // required
 
@@ -1037,7 +1114,7 @@ struct unqualified_id_node
 };
 
 
-struct qualified_id_node
+struct qualified_id_node : parse_tree_allocated
 {
     struct term {
         token const* scope_op;
@@ -1115,7 +1192,7 @@ struct qualified_id_node
 };
 
 
-struct type_id_node
+struct type_id_node : parse_tree_allocated
 {
     source_position pos;
 
@@ -1281,7 +1358,7 @@ auto unqualified_id_node::to_string() const
 }
 
 
-struct is_as_expression_node
+struct is_as_expression_node : parse_tree_allocated
 {
     std::unique_ptr<prefix_expression_node> expr;
 
@@ -1396,7 +1473,7 @@ struct is_as_expression_node
 };
 
 
-struct id_expression_node
+struct id_expression_node : parse_tree_allocated
 {
     source_position pos;
 
@@ -1534,7 +1611,7 @@ auto postfix_expression_node::visit(auto& v, int depth)
 
 struct statement_node;
 
-struct compound_statement_node
+struct compound_statement_node : parse_tree_allocated
 {
     source_position open_brace;
     source_position close_brace;
@@ -1556,7 +1633,7 @@ struct compound_statement_node
 };
 
 
-struct selection_statement_node
+struct selection_statement_node : parse_tree_allocated
 {
     bool                                        is_constexpr = false;
     token const*                                identifier   = {};
@@ -1593,7 +1670,7 @@ struct selection_statement_node
 
 struct parameter_declaration_node;
 
-struct iteration_statement_node
+struct iteration_statement_node : parse_tree_allocated
 {
     token const*                                label      = {};
     token const*                                identifier = {};
@@ -1620,7 +1697,7 @@ struct iteration_statement_node
 };
 
 
-struct return_statement_node
+struct return_statement_node : parse_tree_allocated
 {
     token const*                     identifier = {};
     std::unique_ptr<expression_node> expression;
@@ -1644,7 +1721,7 @@ struct return_statement_node
 };
 
 
-struct alternative_node
+struct alternative_node : parse_tree_allocated
 {
     std::unique_ptr<unqualified_id_node> name;
     token const*                         is_as_keyword = {};
@@ -1668,7 +1745,7 @@ struct alternative_node
 };
 
 
-struct inspect_expression_node
+struct inspect_expression_node : parse_tree_allocated
 {
     bool                                     is_constexpr = false;
     token const*                             identifier   = {};
@@ -1705,7 +1782,7 @@ struct inspect_expression_node
 };
 
 
-struct contract_node
+struct contract_node : parse_tree_allocated
 {
     //  Declared first, because it should outlive any owned
     //  postfix_expressions that could refer to it
@@ -1747,7 +1824,7 @@ struct contract_node
 };
 
 
-struct jump_statement_node
+struct jump_statement_node : parse_tree_allocated
 {
     token const* keyword;
     token const* label;
@@ -1776,7 +1853,7 @@ struct jump_statement_node
 
 struct parameter_declaration_list_node;
 
-struct statement_node
+struct statement_node : parse_tree_allocated
 {
     std::unique_ptr<parameter_declaration_list_node> parameters;
     compound_statement_node* compound_parent = nullptr;
@@ -1901,7 +1978,7 @@ auto compound_statement_node::visit(auto& v, int depth)
 }
 
 
-struct parameter_declaration_node
+struct parameter_declaration_node : parse_tree_allocated
 {
     source_position pos = {};
     passing_style pass  = passing_style::in;
@@ -1982,7 +2059,7 @@ struct parameter_declaration_node
 };
 
 
-struct parameter_declaration_list_node
+struct parameter_declaration_list_node : parse_tree_allocated
 {
     token const* open_paren  = {};
     token const* close_paren = {};
@@ -2048,7 +2125,7 @@ auto statement_node::visit(auto& v, int depth)
 
 struct function_returns_tag { };
 
-struct function_type_node
+struct function_type_node : parse_tree_allocated
 {
     declaration_node* my_decl;
 
@@ -2260,7 +2337,7 @@ struct function_type_node
 };
 
 
-struct type_node
+struct type_node : parse_tree_allocated
 {
     token const* type;
     bool         final = false;
@@ -2305,7 +2382,7 @@ struct type_node
 };
 
 
-struct namespace_node
+struct namespace_node : parse_tree_allocated
 {
     token const* namespace_;
 
@@ -2327,7 +2404,7 @@ struct namespace_node
 };
 
 
-struct alias_node
+struct alias_node : parse_tree_allocated
 {
     token const* type = {};
     std::unique_ptr<type_id_node> type_id;   // for objects
@@ -2388,7 +2465,7 @@ auto to_string(accessibility a)
 }
 
 
-struct declaration_node
+struct declaration_node : parse_tree_allocated
 {
     //  The capture_group is declared first, because it should outlive
     //  any owned postfix_expressions that could refer to it
@@ -3790,7 +3867,7 @@ auto parameter_declaration_node::visit(auto& v, int depth)
 }
 
 
-struct translation_unit_node
+struct translation_unit_node : parse_tree_allocated
 {
     std::vector< std::unique_ptr<declaration_node> > declarations;
 
@@ -3888,6 +3965,24 @@ class parser
     mutable bool                              is_function_body_extents_sorted = false;
 
 public:
+    //  How long each type metafunction took to apply, in application order
+    //  (reported by -verbose)
+    struct meta_function_timing {
+        std::string              type_name;
+        std::string              meta_function_name;
+        std::chrono::nanoseconds duration;
+    };
+
+private:
+    std::vector<meta_function_timing> meta_function_timings;
+
+public:
+    auto get_meta_function_timings() const
+        -> std::vector<meta_function_timing> const&
+    {
+        return meta_function_timings;
+    }
+
     auto is_within_function_body(source_position p) const
     {
         //  Short circuit the empty case, so that the rest of the function
@@ -4034,6 +4129,48 @@ public:
     }
 
 
+    //-----------------------------------------------------------------------
+    //  parse_declarations
+    //
+    //  tokens              input tokens for several generated declarations
+    //  generated_tokens    a shared place to store generated tokens
+    //
+    //  Parses statements until the tokens are consumed, so that a batch
+    //  of declarations can be lexed and parsed in one pass. Returns all of
+    //  them, or none if any of them failed to parse.
+    //
+    auto parse_declarations(
+        std::vector<token> const& tokens_,
+        std::deque<token>&        generated_tokens_
+    )
+        -> std::vector<std::unique_ptr<statement_node>>
+    {
+        parse_kind = "source string during code generation";
+
+        //  Set per-parse state for the duration of this call
+        tokens           = &tokens_;
+        generated_tokens = &generated_tokens_;
+
+        auto errors_size = std::ssize(errors);
+        auto ret = std::vector<std::unique_ptr<statement_node>>{};
+        pos = 0;
+        while (!done())
+        {
+            auto d = statement();
+            if (
+                !d
+                || std::ssize(errors) != errors_size
+                )
+            {
+                return {};
+            }
+            ret.push_back( std::move(d) );
+        }
+
+        return ret;
+    }
+
+
     //-----------------------------------------------------------------------
     //  Get a set of pointers to just the declarations in the given token map section
     //
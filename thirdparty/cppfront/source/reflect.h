@@ -17,31 +17,31 @@ namespace meta {
 #line 33 "./thirdparty/cppfront/source/reflect.h2"
 class compiler_services;
 
-#line 178 "./thirdparty/cppfront/source/reflect.h2"
+#line 223 "./thirdparty/cppfront/source/reflect.h2"
 class declaration_base;
 
-#line 202 "./thirdparty/cppfront/source/reflect.h2"
+#line 247 "./thirdparty/cppfront/source/reflect.h2"
 class declaration;
 
-#line 265 "./thirdparty/cppfront/source/reflect.h2"
+#line 310 "./thirdparty/cppfront/source/reflect.h2"
 class parameter_declaration;
 
-#line 292 "./thirdparty/cppfront/source/reflect.h2"
+#line 337 "./thirdparty/cppfront/source/reflect.h2"
 class function_declaration;
 
-#line 366 "./thirdparty/cppfront/source/reflect.h2"
+#line 411 "./thirdparty/cppfront/source/reflect.h2"
 class object_declaration;
 
-#line 402 "./thirdparty/cppfront/source/reflect.h2"
+#line 447 "./thirdparty/cppfront/source/reflect.h2"
 class type_declaration;
 
-#line 508 "./thirdparty/cppfront/source/reflect.h2"
+#line 572 "./thirdparty/cppfront/source/reflect.h2"
 class alias_declaration;
 
-#line 1023 "./thirdparty/cppfront/source/reflect.h2"
+#line 1248 "./thirdparty/cppfront/source/reflect.h2"
 class value_member_info;
 
-#line 1331 "./thirdparty/cppfront/source/reflect.h2"
+#line 1556 "./thirdparty/cppfront/source/reflect.h2"
 }
 }
 
@@ -100,31 +100,51 @@ class compiler_services
         
 
 #line 57 "./thirdparty/cppfront/source/reflect.h2"
-    protected: [[nodiscard]] auto parse_statement(
+    //  Give generated source a stable home (lines and tokens are views into
+    //  it), split it into lines, and lex it as one grammar_map section
+    //
+    protected: [[nodiscard]] auto lex_generated_source(
 
         std::string_view source
     ) & -> 
-        std::unique_ptr<statement_node>;
+        tokens*;
 
 #line 105 "./thirdparty/cppfront/source/reflect.h2"
+    protected: [[nodiscard]] auto parse_statement(
+
+        cpp2::in<std::string_view> source
+    ) & -> 
+        std::unique_ptr<statement_node>;
+
+#line 121 "./thirdparty/cppfront/source/reflect.h2"
+    //  Lex and parse several declarations in one pass, instead of setting
+    //  up the lexer and parser again for each one
+    //
+    protected: [[nodiscard]] auto parse_statements(
+
+        cpp2::in<std::vector<std::string>> sources
+    ) & -> 
+        std::vector<std::unique_ptr<statement_node>>;
+
+#line 150 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] virtual auto position() const& -> 
         source_position; 
 
-#line 111 "./thirdparty/cppfront/source/reflect.h2"
+#line 156 "./thirdparty/cppfront/source/reflect.h2"
     public: auto require(
 
         cpp2::in<bool> b, 
         cpp2::in<std::string_view> msg
     ) const& -> void;
 
-#line 122 "./thirdparty/cppfront/source/reflect.h2"
+#line 167 "./thirdparty/cppfront/source/reflect.h2"
     public: auto error(cpp2::in<std::string_view> msg) const& -> void;
     
     public: virtual ~compiler_services() noexcept;
 public: compiler_services(compiler_services const& that);
 
 
-#line 130 "./thirdparty/cppfront/source/reflect.h2"
+#line 175 "./thirdparty/cppfront/source/reflect.h2"
 };
 
 /*
@@ -163,7 +183,7 @@ type_id: @polymorphic_base @copyable type =
 }
 */
 
-#line 169 "./thirdparty/cppfront/source/reflect.h2"
+#line 214 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //  Declarations
@@ -176,7 +196,7 @@ type_id: @polymorphic_base @copyable type =
 class declaration_base
 : public compiler_services {
 
-#line 182 "./thirdparty/cppfront/source/reflect.h2"
+#line 227 "./thirdparty/cppfront/source/reflect.h2"
     protected: declaration_node* n; 
 
     protected: explicit declaration_base(
@@ -185,29 +205,29 @@ class declaration_base
         cpp2::in<compiler_services> s
     );
 
-#line 195 "./thirdparty/cppfront/source/reflect.h2"
+#line 240 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto position() const& -> source_position override;
 
 public: virtual ~declaration_base() noexcept;
 public: declaration_base(declaration_base const& that);
-#line 196 "./thirdparty/cppfront/source/reflect.h2"
+#line 241 "./thirdparty/cppfront/source/reflect.h2"
 };
 
-#line 199 "./thirdparty/cppfront/source/reflect.h2"
+#line 244 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //  All declarations
 //
 class declaration
 : public declaration_base {
 
-#line 206 "./thirdparty/cppfront/source/reflect.h2"
+#line 251 "./thirdparty/cppfront/source/reflect.h2"
     public: explicit declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     );
 
-#line 215 "./thirdparty/cppfront/source/reflect.h2"
+#line 260 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto is_public() const& -> bool;
     public: [[nodiscard]] auto is_protected() const& -> bool;
     public: [[nodiscard]] auto is_private() const& -> bool;
@@ -227,7 +247,7 @@ class declaration
     public: [[nodiscard]] auto name() const& -> std::string_view;
         
 
-#line 236 "./thirdparty/cppfront/source/reflect.h2"
+#line 281 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto has_initializer() const& -> bool;
 
     public: [[nodiscard]] auto is_global() const& -> bool;
@@ -255,7 +275,7 @@ class declaration
 
 public: virtual ~declaration() noexcept;
 public: declaration(declaration const& that);
-#line 260 "./thirdparty/cppfront/source/reflect.h2"
+#line 305 "./thirdparty/cppfront/source/reflect.h2"
 };
 
 //-----------------------------------------------------------------------
@@ -264,18 +284,18 @@ public: declaration(declaration const& that);
 class parameter_declaration
 : public declaration {
 
-#line 269 "./thirdparty/cppfront/source/reflect.h2"
+#line 314 "./thirdparty/cppfront/source/reflect.h2"
     public: explicit parameter_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     );
 
-#line 278 "./thirdparty/cppfront/source/reflect.h2"
+#line 323 "./thirdparty/cppfront/source/reflect.h2"
  public: auto visit(auto& visitor) & -> void;
   
 
-#line 282 "./thirdparty/cppfront/source/reflect.h2"
+#line 327 "./thirdparty/cppfront/source/reflect.h2"
  public: [[nodiscard]] auto is_a_parameter() const& -> bool;
  public: [[nodiscard]] auto is_type() const& -> bool;
  //is_type_id				: (this) -> bool  = n*.is_type_id();
@@ -283,7 +303,7 @@ class parameter_declaration
 
 public: parameter_declaration(parameter_declaration const& that);
 
-#line 287 "./thirdparty/cppfront/source/reflect.h2"
+#line 332 "./thirdparty/cppfront/source/reflect.h2"
 };
 
 //-----------------------------------------------------------------------
@@ -292,18 +312,18 @@ public: parameter_declaration(parameter_declaration const& that);
 class function_declaration
 : public declaration {
 
-#line 296 "./thirdparty/cppfront/source/reflect.h2"
+#line 341 "./thirdparty/cppfront/source/reflect.h2"
     public: explicit function_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     );
 
-#line 306 "./thirdparty/cppfront/source/reflect.h2"
+#line 351 "./thirdparty/cppfront/source/reflect.h2"
  public: auto visit(auto& visitor) & -> void;
   
 
-#line 310 "./thirdparty/cppfront/source/reflect.h2"
+#line 355 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto index_of_parameter_named(cpp2::in<std::string_view> s) const& -> int;
     public: [[nodiscard]] auto has_parameter_named(cpp2::in<std::string_view> s) const& -> bool;
     public: [[nodiscard]] auto has_in_parameter_named(cpp2::in<std::string_view> s) const& -> bool;
@@ -313,7 +333,7 @@ class function_declaration
  public: [[nodiscard]] auto get_parameters() const& -> 
         std::vector<parameter_declaration>; 
 
-#line 329 "./thirdparty/cppfront/source/reflect.h2"
+#line 374 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto has_parameter_with_name_and_pass(cpp2::in<std::string_view> s, cpp2::in<passing_style> pass) const& -> bool;
                                                   
     public: [[nodiscard]] auto is_function_with_this() const& -> bool;
@@ -347,54 +367,54 @@ class function_declaration
     public: [[nodiscard]] auto make_virtual() & -> bool;
 
 public: function_declaration(function_declaration const& that);
-#line 360 "./thirdparty/cppfront/source/reflect.h2"
+#line 405 "./thirdparty/cppfront/source/reflect.h2"
 };
 
-#line 363 "./thirdparty/cppfront/source/reflect.h2"
+#line 408 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //  Object declarations
 //
 class object_declaration
 : public declaration {
 
-#line 370 "./thirdparty/cppfront/source/reflect.h2"
+#line 415 "./thirdparty/cppfront/source/reflect.h2"
     public: explicit object_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     );
 
-#line 380 "./thirdparty/cppfront/source/reflect.h2"
+#line 425 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto is_const() const& -> bool;
     public: [[nodiscard]] auto has_wildcard_type() const& -> bool;
 
     public: [[nodiscard]] auto type() const& -> std::string;
         
 
-#line 390 "./thirdparty/cppfront/source/reflect.h2"
+#line 435 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto initializer() const& -> std::string;
         
         public: object_declaration(object_declaration const& that);
 
 
-#line 396 "./thirdparty/cppfront/source/reflect.h2"
+#line 441 "./thirdparty/cppfront/source/reflect.h2"
 };
 
-#line 399 "./thirdparty/cppfront/source/reflect.h2"
+#line 444 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //  Type declarations
 //
 class type_declaration
 : public declaration {
 
-#line 406 "./thirdparty/cppfront/source/reflect.h2"
+#line 451 "./thirdparty/cppfront/source/reflect.h2"
     public: explicit type_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     );
 
-#line 416 "./thirdparty/cppfront/source/reflect.h2"
+#line 461 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto is_polymorphic() const& -> bool;
     public: [[nodiscard]] auto is_final() const& -> bool;
     public: [[nodiscard]] auto make_final() & -> bool;
@@ -402,69 +422,74 @@ class type_declaration
  public: auto visit(auto& visitor) & -> void;
   
 
-#line 424 "./thirdparty/cppfront/source/reflect.h2"
+#line 469 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto get_member_functions() const& -> 
         std::vector<function_declaration>; 
 
-#line 434 "./thirdparty/cppfront/source/reflect.h2"
+#line 479 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto get_member_objects() const& -> 
         std::vector<object_declaration>; 
 
-#line 444 "./thirdparty/cppfront/source/reflect.h2"
+#line 489 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto get_member_types() const& -> 
         std::vector<type_declaration>; 
 
-#line 454 "./thirdparty/cppfront/source/reflect.h2"
+#line 499 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto get_member_aliases() const& -> 
         std::vector<alias_declaration>; 
 
-#line 464 "./thirdparty/cppfront/source/reflect.h2"
+#line 509 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto get_members() const& -> 
         std::vector<declaration>; struct query_declared_value_set_functions__ret { bool out_this_in_that; bool out_this_move_that; bool inout_this_in_that; bool inout_this_move_that; };
 
 
 
-#line 474 "./thirdparty/cppfront/source/reflect.h2"
+#line 519 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto query_declared_value_set_functions() const& -> query_declared_value_set_functions__ret;
         
 
-#line 489 "./thirdparty/cppfront/source/reflect.h2"
+#line 534 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto add_member(cpp2::in<std::string_view> source) & -> 
         bool; 
 
-#line 499 "./thirdparty/cppfront/source/reflect.h2"
+#line 544 "./thirdparty/cppfront/source/reflect.h2"
+    //  Like add_member for each source in order, but lexed and parsed together
+    public: [[nodiscard]] auto add_members(cpp2::in<std::vector<std::string>> sources) & -> 
+        bool; 
+
+#line 563 "./thirdparty/cppfront/source/reflect.h2"
     public: auto remove_all_members() & -> void;
 
     public: auto disable_member_function_generation() & -> void;
 
 public: type_declaration(type_declaration const& that);
-#line 502 "./thirdparty/cppfront/source/reflect.h2"
+#line 566 "./thirdparty/cppfront/source/reflect.h2"
 };
 
-#line 505 "./thirdparty/cppfront/source/reflect.h2"
+#line 569 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //  Alias declarations
 //
 class alias_declaration
 : public declaration {
 
-#line 512 "./thirdparty/cppfront/source/reflect.h2"
+#line 576 "./thirdparty/cppfront/source/reflect.h2"
     public: explicit alias_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     );
 
-#line 522 "./thirdparty/cppfront/source/reflect.h2"
+#line 586 "./thirdparty/cppfront/source/reflect.h2"
     public: [[nodiscard]] auto is_type_alias() const& -> bool;
     public: [[nodiscard]] auto is_namespace_alias() const& -> bool;
     public: [[nodiscard]] auto is_object_alias() const& -> bool;
 
 public: alias_declaration(alias_declaration const& that);
-#line 525 "./thirdparty/cppfront/source/reflect.h2"
+#line 589 "./thirdparty/cppfront/source/reflect.h2"
 };
 
-#line 528 "./thirdparty/cppfront/source/reflect.h2"
+#line 592 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //  Metafunctions - these are hardwired for now until we get to the
@@ -479,7 +504,7 @@ public: alias_declaration(alias_declaration const& that);
 //
 auto add_virtual_destructor(meta::type_declaration& t) -> void;
 
-#line 547 "./thirdparty/cppfront/source/reflect.h2"
+#line 611 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //      "... an abstract base class defines an interface ..."
@@ -494,7 +519,7 @@ auto add_virtual_destructor(meta::type_declaration& t) -> void;
 //
 auto interface(meta::type_declaration& t) -> void;
 
-#line 586 "./thirdparty/cppfront/source/reflect.h2"
+#line 650 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //     "C.35: A base class destructor should be either public and
@@ -516,7 +541,7 @@ auto interface(meta::type_declaration& t) -> void;
 //
 auto polymorphic_base(meta::type_declaration& t) -> void;
 
-#line 630 "./thirdparty/cppfront/source/reflect.h2"
+#line 694 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //     "... A totally ordered type ... requires operator<=> that
@@ -542,7 +567,7 @@ auto ordered_impl(
     cpp2::in<std::string_view> ordering// must be "strong_ordering" etc.
 ) -> void;
 
-#line 675 "./thirdparty/cppfront/source/reflect.h2"
+#line 739 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //  ordered - a totally ordered type
 //
@@ -550,25 +575,40 @@ auto ordered_impl(
 //
 auto ordered(meta::type_declaration& t) -> void;
 
-#line 685 "./thirdparty/cppfront/source/reflect.h2"
+#line 749 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //  weakly_ordered - a weakly ordered type
 //
 auto weakly_ordered(meta::type_declaration& t) -> void;
 
-#line 693 "./thirdparty/cppfront/source/reflect.h2"
+#line 757 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //  partially_ordered - a partially ordered type
 //
 auto partially_ordered(meta::type_declaration& t) -> void;
 
-#line 702 "./thirdparty/cppfront/source/reflect.h2"
+#line 766 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //  cpp2_component - a component type
 //
 auto cpp2_component(meta::type_declaration& t) -> void;
 
-#line 864 "./thirdparty/cppfront/source/reflect.h2"
+#line 1066 "./thirdparty/cppfront/source/reflect.h2"
+//-----------------------------------------------------------------------
+//  double_buffered - a component whose `in` readers in other systems see
+//  the previous frame's values, so they never wait on this frame's writers
+//
+auto double_buffered(meta::type_declaration& t) -> void;
+
+#line 1077 "./thirdparty/cppfront/source/reflect.h2"
+//-----------------------------------------------------------------------
+//  on_change - a component whose update steps only visit the rows of
+//  chunks changed since the step ran in the previous frame, so they must
+//  tolerate seeing a row again
+//
+auto on_change(meta::type_declaration& t) -> void;
+
+#line 1089 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //     "A value is ... a regular type. It must have all public
@@ -587,7 +627,7 @@ auto cpp2_component(meta::type_declaration& t) -> void;
 //
 auto copyable(meta::type_declaration& t) -> void;
 
-#line 902 "./thirdparty/cppfront/source/reflect.h2"
+#line 1127 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //  basic_value
@@ -597,7 +637,7 @@ auto copyable(meta::type_declaration& t) -> void;
 //
 auto basic_value(meta::type_declaration& t) -> void;
 
-#line 928 "./thirdparty/cppfront/source/reflect.h2"
+#line 1153 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //     "A 'value' is a totally ordered basic_value..."
@@ -610,16 +650,16 @@ auto basic_value(meta::type_declaration& t) -> void;
 //
 auto value(meta::type_declaration& t) -> void;
 
-#line 944 "./thirdparty/cppfront/source/reflect.h2"
+#line 1169 "./thirdparty/cppfront/source/reflect.h2"
 auto weakly_ordered_value(meta::type_declaration& t) -> void;
 
-#line 950 "./thirdparty/cppfront/source/reflect.h2"
+#line 1175 "./thirdparty/cppfront/source/reflect.h2"
 auto partially_ordered_value(meta::type_declaration& t) -> void;
 
-#line 956 "./thirdparty/cppfront/source/reflect.h2"
+#line 1181 "./thirdparty/cppfront/source/reflect.h2"
 auto cpp2_component_value(meta::type_declaration& t) -> void;
 
-#line 963 "./thirdparty/cppfront/source/reflect.h2"
+#line 1188 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //     "By definition, a `struct` is a `class` in which members
@@ -647,7 +687,7 @@ auto cpp2_component_value(meta::type_declaration& t) -> void;
 //
 auto cpp2_struct(meta::type_declaration& t) -> void;
 
-#line 1006 "./thirdparty/cppfront/source/reflect.h2"
+#line 1231 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //     "C enumerations constitute a curiously half-baked concept. ...
@@ -672,14 +712,14 @@ class value_member_info {
 };
 struct basic_enum__ret { std::string underlying_type; std::string strict_underlying_type; };
 
-#line 1029 "./thirdparty/cppfront/source/reflect.h2"
+#line 1254 "./thirdparty/cppfront/source/reflect.h2"
 [[nodiscard]] auto basic_enum(
     meta::type_declaration& t, 
     auto const& nextval, 
     cpp2::in<bool> bitwise
     ) -> basic_enum__ret;
 
-#line 1190 "./thirdparty/cppfront/source/reflect.h2"
+#line 1415 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //    "An enum[...] is a totally ordered value type that stores a
@@ -691,7 +731,7 @@ struct basic_enum__ret { std::string underlying_type; std::string strict_underly
 //
 auto cpp2_enum(meta::type_declaration& t) -> void;
 
-#line 1215 "./thirdparty/cppfront/source/reflect.h2"
+#line 1440 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //     "flag_enum expresses an enumeration that stores values 
@@ -704,7 +744,7 @@ auto cpp2_enum(meta::type_declaration& t) -> void;
 //
 auto flag_enum(meta::type_declaration& t) -> void;
 
-#line 1250 "./thirdparty/cppfront/source/reflect.h2"
+#line 1475 "./thirdparty/cppfront/source/reflect.h2"
 //-----------------------------------------------------------------------
 //
 //     "As with void*, programmers should know that unions [...] are
@@ -731,7 +771,7 @@ auto flag_enum(meta::type_declaration& t) -> void;
 
 auto cpp2_union(meta::type_declaration& t) -> void;
 
-#line 1329 "./thirdparty/cppfront/source/reflect.h2"
+#line 1554 "./thirdparty/cppfront/source/reflect.h2"
 //=======================================================================
 //  Switch to Cpp1 and close subnamespace meta
 }
@@ -761,6 +801,16 @@ auto parser::apply_type_meta_functions( declaration_node& n )
         auto name = meta->to_string();
         rtype.set_meta_function_name( name );
 
+        //  Record how long this one took, for -verbose
+        auto start = std::chrono::steady_clock::now();
+        auto record_timing = finally([&]{
+            meta_function_timings.push_back({
+                n.name() ? n.name()->to_string(true) : std::string{"(unnamed)"},
+                name,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+            });
+        });
+
         if (name == "interface") {
             interface( rtype );
         }
@@ -806,8 +856,14 @@ auto parser::apply_type_meta_functions( declaration_node& n )
         else if (name == "component") {
             cpp2_component( rtype );
         }
+        else if (name == "double_buffered") {
+            double_buffered( rtype );
+        }
+        else if (name == "on_change") {
+            on_change( rtype );
+        }
         else {
-            error( "(temporary alpha limitation) unrecognized metafunction name '" + name + "' - currently the supported names are: interface, polymorphic_base, ordered, weakly_ordered, partially_ordered, copyable, basic_value, value, weakly_ordered_value, partially_ordered_value, struct, enum, flag_enum, union" );
+            error( "(temporary alpha limitation) unrecognized metafunction name '" + name + "' - currently the supported names are: interface, polymorphic_base, ordered, weakly_ordered, partially_ordered, copyable, basic_value, value, weakly_ordered_value, partially_ordered_value, struct, enum, flag_enum, union, component, double_buffered, on_change" );
             return false;
         }
     }
@@ -846,12 +902,16 @@ namespace meta {
         meta_function_name = s;
     }
 
-    [[nodiscard]] auto compiler_services::parse_statement(
+#line 60 "./thirdparty/cppfront/source/reflect.h2"
+    [[nodiscard]] auto compiler_services::lex_generated_source(
 
         std::string_view source
     ) & -> 
-        std::unique_ptr<statement_node>
+        tokens*
     {
+        CPP2_UFCS(push_back, generated_text, std::string(source));
+        source = CPP2_UFCS_0(back, generated_text);
+
         CPP2_UFCS(push_back, generated_lines, std::vector<source_line>());
         auto lines {&CPP2_UFCS_0(back, generated_lines)}; 
 
@@ -864,7 +924,7 @@ auto newline_pos = CPP2_UFCS(find, source, '\n');
         //  First split this string into source_lines
         //
 
-#line 73 "./thirdparty/cppfront/source/reflect.h2"
+#line 79 "./thirdparty/cppfront/source/reflect.h2"
         if ( cpp2::cmp_greater(CPP2_UFCS_0(ssize, source),1) 
             && newline_pos != source.npos) 
         {
@@ -877,7 +937,7 @@ auto newline_pos = CPP2_UFCS(find, source, '\n');
         }
 }
 
-#line 84 "./thirdparty/cppfront/source/reflect.h2"
+#line 90 "./thirdparty/cppfront/source/reflect.h2"
         if (!(CPP2_UFCS_0(empty, source))) {
             std::move(add_line)(std::move(source));
         }
@@ -890,6 +950,16 @@ auto newline_pos = CPP2_UFCS(find, source, '\n');
         CPP2_UFCS(lex, (*cpp2::assert_not_null(tokens)), *cpp2::assert_not_null(std::move(lines)), true);
 
         cpp2::Default.expects(std::ssize(CPP2_UFCS_0(get_map, (*cpp2::assert_not_null(tokens)))) == 1, "");
+        return tokens; 
+    }
+
+    [[nodiscard]] auto compiler_services::parse_statement(
+
+        cpp2::in<std::string_view> source
+    ) & -> 
+        std::unique_ptr<statement_node>
+    {
+        auto tokens {lex_generated_source(source)}; 
 
         //  Now parse this single declaration from
         //  the lexed tokens
@@ -899,6 +969,38 @@ auto newline_pos = CPP2_UFCS(find, source, '\n');
         ); 
     }
 
+#line 124 "./thirdparty/cppfront/source/reflect.h2"
+    [[nodiscard]] auto compiler_services::parse_statements(
+
+        cpp2::in<std::vector<std::string>> sources
+    ) & -> 
+        std::vector<std::unique_ptr<statement_node>>
+    {
+        //  Each source starts on its own line, and its tokens are then
+        //  renumbered from there so the result matches lexing it alone
+        std::string joined {}; 
+        std::vector<lineno_t> fragment_starts {}; 
+{
+lineno_t next_start = 0;
+
+#line 135 "./thirdparty/cppfront/source/reflect.h2"
+        for ( auto const& source : sources ) {
+            CPP2_UFCS(push_back, fragment_starts, next_start);
+            next_start += cpp2::unsafe_narrow<lineno_t>(std::ranges::count(source, '\n')) + 1;
+            joined += source;
+            joined += '\n';
+        }
+}
+#line 141 "./thirdparty/cppfront/source/reflect.h2"
+        auto tokens {lex_generated_source(joined)}; 
+        CPP2_UFCS(restart_line_numbers, (*cpp2::assert_not_null(tokens)), std::move(fragment_starts));
+
+        return CPP2_UFCS(parse_declarations, parser, 
+            (*cpp2::assert_not_null(CPP2_UFCS_0(begin, CPP2_UFCS_0(get_map, *cpp2::assert_not_null(std::move(tokens)))))).second, 
+            *cpp2::assert_not_null(generated_tokens)
+        ); 
+    }
+
     [[nodiscard]] auto compiler_services::position() const& -> 
         source_position
     {
@@ -933,7 +1035,7 @@ compiler_services::compiler_services(compiler_services const& that)
                                 , parser{ that.parser }
                                 , meta_function_name{ that.meta_function_name }{}
 
-#line 184 "./thirdparty/cppfront/source/reflect.h2"
+#line 229 "./thirdparty/cppfront/source/reflect.h2"
     declaration_base::declaration_base(
 
         declaration_node* n_, 
@@ -941,10 +1043,10 @@ compiler_services::compiler_services(compiler_services const& that)
     )
         : compiler_services{ s }
         , n{ n_ }
-#line 189 "./thirdparty/cppfront/source/reflect.h2"
+#line 234 "./thirdparty/cppfront/source/reflect.h2"
     {
 
-#line 192 "./thirdparty/cppfront/source/reflect.h2"
+#line 237 "./thirdparty/cppfront/source/reflect.h2"
         cpp2::Default.expects(n, "a meta::declaration must point to a valid declaration_node, not null");
     }
 
@@ -955,14 +1057,14 @@ declaration_base::declaration_base(declaration_base const& that)
                                 : compiler_services{ static_cast<compiler_services const&>(that) }
                                 , n{ that.n }{}
 
-#line 206 "./thirdparty/cppfront/source/reflect.h2"
+#line 251 "./thirdparty/cppfront/source/reflect.h2"
     declaration::declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     )
         : declaration_base{ n_, s }
-#line 211 "./thirdparty/cppfront/source/reflect.h2"
+#line 256 "./thirdparty/cppfront/source/reflect.h2"
     {
 
     }
@@ -1017,14 +1119,14 @@ declaration_base::declaration_base(declaration_base const& that)
 declaration::declaration(declaration const& that)
                                 : declaration_base{ static_cast<declaration_base const&>(that) }{}
 
-#line 269 "./thirdparty/cppfront/source/reflect.h2"
+#line 314 "./thirdparty/cppfront/source/reflect.h2"
     parameter_declaration::parameter_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     )
         : declaration{ n_, s }
-#line 274 "./thirdparty/cppfront/source/reflect.h2"
+#line 319 "./thirdparty/cppfront/source/reflect.h2"
     {
 
     }
@@ -1041,14 +1143,14 @@ declaration::declaration(declaration const& that)
  parameter_declaration::parameter_declaration(parameter_declaration const& that)
                                 : declaration{ static_cast<declaration const&>(that) }{}
 
-#line 296 "./thirdparty/cppfront/source/reflect.h2"
+#line 341 "./thirdparty/cppfront/source/reflect.h2"
     function_declaration::function_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     )
         : declaration{ n_, s }
-#line 301 "./thirdparty/cppfront/source/reflect.h2"
+#line 346 "./thirdparty/cppfront/source/reflect.h2"
     {
 
         cpp2::Default.expects(CPP2_UFCS_0(is_function, (*cpp2::assert_not_null(n))), "");
@@ -1112,14 +1214,14 @@ declaration::declaration(declaration const& that)
     function_declaration::function_declaration(function_declaration const& that)
                                 : declaration{ static_cast<declaration const&>(that) }{}
 
-#line 370 "./thirdparty/cppfront/source/reflect.h2"
+#line 415 "./thirdparty/cppfront/source/reflect.h2"
     object_declaration::object_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     )
         : declaration{ n_, s }
-#line 375 "./thirdparty/cppfront/source/reflect.h2"
+#line 420 "./thirdparty/cppfront/source/reflect.h2"
     {
 
         cpp2::Default.expects(CPP2_UFCS_0(is_object, (*cpp2::assert_not_null(n))), "");
@@ -1145,14 +1247,14 @@ declaration::declaration(declaration const& that)
     object_declaration::object_declaration(object_declaration const& that)
                                 : declaration{ static_cast<declaration const&>(that) }{}
 
-#line 406 "./thirdparty/cppfront/source/reflect.h2"
+#line 451 "./thirdparty/cppfront/source/reflect.h2"
     type_declaration::type_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     )
         : declaration{ n_, s }
-#line 411 "./thirdparty/cppfront/source/reflect.h2"
+#line 456 "./thirdparty/cppfront/source/reflect.h2"
     {
 
         cpp2::Default.expects(CPP2_UFCS_0(is_type, (*cpp2::assert_not_null(n))), "");
@@ -1218,13 +1320,13 @@ declaration::declaration(declaration const& that)
 
     [[nodiscard]] auto type_declaration::query_declared_value_set_functions() const& -> query_declared_value_set_functions__ret
 
-#line 481 "./thirdparty/cppfront/source/reflect.h2"
+#line 526 "./thirdparty/cppfront/source/reflect.h2"
     {
             cpp2::deferred_init<bool> out_this_in_that;
             cpp2::deferred_init<bool> out_this_move_that;
             cpp2::deferred_init<bool> inout_this_in_that;
             cpp2::deferred_init<bool> inout_this_move_that;
-#line 482 "./thirdparty/cppfront/source/reflect.h2"
+#line 527 "./thirdparty/cppfront/source/reflect.h2"
         auto declared {CPP2_UFCS_0(find_declared_value_set_functions, (*cpp2::assert_not_null(n)))}; 
         out_this_in_that.construct(declared.out_this_in_that != nullptr);
         out_this_move_that.construct(declared.out_this_move_that != nullptr);
@@ -1242,6 +1344,25 @@ declaration::declaration(declaration const& that)
         return false; 
     }
 
+#line 545 "./thirdparty/cppfront/source/reflect.h2"
+    [[nodiscard]] auto type_declaration::add_members(cpp2::in<std::vector<std::string>> sources) & -> 
+        bool
+    {
+        if (CPP2_UFCS_0(empty, sources)) {
+            return true; 
+        }
+        auto decls {parse_statements(sources)}; 
+        if (CPP2_UFCS_0(empty, decls)) {
+            return false; 
+        }
+        for ( auto& decl : decls ) {
+            if (!(CPP2_UFCS(add_type_member, (*cpp2::assert_not_null(n)), std::move(decl)))) {
+                return false; 
+            }
+        }
+        return true; 
+    }
+
     auto type_declaration::remove_all_members() & -> void { CPP2_UFCS_0(type_remove_all_members, (*cpp2::assert_not_null(n)));  }
 
     auto type_declaration::disable_member_function_generation() & -> void { CPP2_UFCS_0(type_disable_member_function_generation, (*cpp2::assert_not_null(n)));  }
@@ -1249,14 +1370,14 @@ declaration::declaration(declaration const& that)
     type_declaration::type_declaration(type_declaration const& that)
                                 : declaration{ static_cast<declaration const&>(that) }{}
 
-#line 512 "./thirdparty/cppfront/source/reflect.h2"
+#line 576 "./thirdparty/cppfront/source/reflect.h2"
     alias_declaration::alias_declaration(
 
         declaration_node* n_, 
         cpp2::in<compiler_services> s
     )
         : declaration{ n_, s }
-#line 517 "./thirdparty/cppfront/source/reflect.h2"
+#line 581 "./thirdparty/cppfront/source/reflect.h2"
     {
 
         cpp2::Default.expects(CPP2_UFCS_0(is_alias, (*cpp2::assert_not_null(n))), "");
@@ -1269,14 +1390,14 @@ declaration::declaration(declaration const& that)
     alias_declaration::alias_declaration(alias_declaration const& that)
                                 : declaration{ static_cast<declaration const&>(that) }{}
 
-#line 540 "./thirdparty/cppfront/source/reflect.h2"
+#line 604 "./thirdparty/cppfront/source/reflect.h2"
 auto add_virtual_destructor(meta::type_declaration& t) -> void
 {
     CPP2_UFCS(require, t, CPP2_UFCS(add_member, t, "operator=: (virtual move this) = { }"), 
                "could not add virtual destructor");
 }
 
-#line 559 "./thirdparty/cppfront/source/reflect.h2"
+#line 623 "./thirdparty/cppfront/source/reflect.h2"
 auto interface(meta::type_declaration& t) -> void
 {
     auto has_dtor {false}; 
@@ -1303,7 +1424,7 @@ auto interface(meta::type_declaration& t) -> void
     }
 }
 
-#line 605 "./thirdparty/cppfront/source/reflect.h2"
+#line 669 "./thirdparty/cppfront/source/reflect.h2"
 auto polymorphic_base(meta::type_declaration& t) -> void
 {
     auto has_dtor {false}; 
@@ -1328,7 +1449,7 @@ auto polymorphic_base(meta::type_declaration& t) -> void
     }
 }
 
-#line 650 "./thirdparty/cppfront/source/reflect.h2"
+#line 714 "./thirdparty/cppfront/source/reflect.h2"
 auto ordered_impl(
     meta::type_declaration& t, 
     cpp2::in<std::string_view> ordering
@@ -1354,33 +1475,73 @@ auto ordered_impl(
     }
 }
 
-#line 680 "./thirdparty/cppfront/source/reflect.h2"
+#line 744 "./thirdparty/cppfront/source/reflect.h2"
 auto ordered(meta::type_declaration& t) -> void
 {
     ordered_impl(t, "strong_ordering");
 }
 
-#line 688 "./thirdparty/cppfront/source/reflect.h2"
+#line 752 "./thirdparty/cppfront/source/reflect.h2"
 auto weakly_ordered(meta::type_declaration& t) -> void
 {
     ordered_impl(t, "weak_ordering");
 }
 
-#line 696 "./thirdparty/cppfront/source/reflect.h2"
+#line 760 "./thirdparty/cppfront/source/reflect.h2"
 auto partially_ordered(meta::type_declaration& t) -> void
 {
     ordered_impl(t, "partial_ordering");
 }
 
-#line 705 "./thirdparty/cppfront/source/reflect.h2"
+#line 769 "./thirdparty/cppfront/source/reflect.h2"
 auto cpp2_component(meta::type_declaration& t) -> void
 {
- std::string component_function_string {""}; 
-    component_function_string += "ComponentFunctions: () -> std::vector<ComponentTask> = { \n";
-    component_function_string += "    result : std::vector<ComponentTask> = ();\n";
+    //  Gather the data members before any generated members are added
+    std::string memberNameString {""}; 
+    auto first {true}; 
+ for ( auto& m : CPP2_UFCS_0(get_members, t) ) 
+    {
+        if (CPP2_UFCS_0(is_function, m)) {
+   continue;
+  }
+        if (CPP2_UFCS_0(is_object, m)) {
+            auto mf {CPP2_UFCS_0(as_object, m)}; 
+        }
+
+        if (CPP2_UFCS_0(has_name, m)) {
+            auto memberName {"\"" + (cpp2::as_<std::string>(CPP2_UFCS_0(name, m))) + "\""}; 
+            if ((first)) {
+               memberNameString += memberName;
+               first = false;
+            }else {
+               memberNameString += ", " + memberName;
+            }
+
+   CPP2_UFCS_0(default_to_public, m);
+   //m.require( m.make_public(), "all data members must be public");
+        }
+    }
+
+ //  Static constexpr tables, dependencies and fields are ranges into the flat tables
+ std::string tasks_string {""}; 
+ std::string dependencies_string {""}; 
+ std::string fields_string {""}; 
+ auto numDependencies {0}; 
+ auto numFields {0}; 
+
+ //  Generated members are collected and added together at the end
+ std::vector<std::string> generated_members {}; 
+
+ //  A component may declare its own Run<Step>, to batch work over the rows of a range; the
+ //  step's Call<Step> and task tables are still generated from the step
+ std::vector<std::string> declared_runs {}; 
+ for ( auto const& f : CPP2_UFCS_0(get_member_functions, t) ) {
+  if (CPP2_UFCS_0(has_name, f) && CPP2_UFCS(starts_with, (cpp2::as_<std::string>(CPP2_UFCS_0(name, f))), "Run")) {
+   CPP2_UFCS(push_back, declared_runs, cpp2::as_<std::string>(CPP2_UFCS_0(name, f)));
+  }
+ }
 
  //functionDebug : std::string = "";
- //firstFunction := true;
     for ( auto& f : CPP2_UFCS_0(get_member_functions, t) ) 
     {
   auto param_parser {cpp2_new<parse_params>()}; 
@@ -1394,22 +1555,26 @@ auto cpp2_component(meta::type_declaration& t) -> void
   if (((id != "Update") && (id != "PreUpdate") && (id != "PostUpdate"))) {
    continue;
   }
+  CPP2_UFCS(require, f, !((*cpp2::assert_not_null(param_parser)).m_error), id + ": " + (*cpp2::assert_not_null(param_parser)).m_errorMsg);
+
+  auto field_parser {cpp2_new<parse_field_accesses>((*cpp2::assert_not_null(param_parser)).m_params)}; 
+  CPP2_UFCS(visit, f, *cpp2::assert_not_null(field_parser));
 
+  std::string call_lookup_string {""}; 
   std::string call_update_string {""}; 
-  call_update_string += "Call" + id + ": (inout this, inout ctx : ECS_Context, inout cm : ComponentManager) = { \n";
   call_update_string += "    " + id + "(";
 
-  auto idFn {id + "Fn"}; 
+  //  Batch shim: systems are looked up once per range, not per entity, and the
+  //  component parameters are joined on the entity by JoinRows
+  std::string run_lookup_string {""}; 
+  std::string run_args_string {""}; 
+  std::string run_join_params_string {""}; 
+  std::string run_join_systems_string {""}; 
 
-  //if (firstFunction) {
-  //	firstFunction = false;
-  //} else {
-  //	//component_function_string += ",";
-  //}
+  //  Written components stamp their chunk's change version with the job's frame
+  auto this_written {false}; 
 
-  component_function_string += idFn + " :=  ComponentTask(";
-  component_function_string += "\"" + id + "\"";
-  component_function_string += ", std::vector<ComponentTask::Dependency>());\n";
+  auto firstDependency {numDependencies}; 
 
   //functionDebug += id;
   //functionDebug += "(";
@@ -1420,118 +1585,226 @@ auto cpp2_component(meta::type_declaration& t) -> void
     firstParam = false;
    }else {
     call_update_string += ", ";
+    run_args_string += ", ";
    }
 
-   component_function_string += idFn + ".mDepends.push_back( ComponentTask::Dependency(";
+   std::string dependency_string {"ComponentTask::Dependency("}; 
 
    if (param.m_dir == parse_params::Param::Direction::in) {
     //functionDebug += "in ";
-    component_function_string += "ComponentTask::Dependency::Direction::in, ";
+    dependency_string += "ComponentTask::Dependency::Direction::in, ";
    }
    else {if (param.m_dir == parse_params::Param::Direction::inout) {
     //functionDebug += "inout ";
-    component_function_string += "ComponentTask::Dependency::Direction::inout, ";
+    dependency_string += "ComponentTask::Dependency::Direction::inout, ";
    }
    else {if (param.m_dir == parse_params::Param::Direction::out) {
     //functionDebug += "out ";
-    component_function_string += "ComponentTask::Dependency::Direction::out, ";
+    dependency_string += "ComponentTask::Dependency::Direction::out, ";
    }
    else {
     //functionDebug += "unknown ";
-    component_function_string += "ComponentTask::Dependency::Direction::unknown, ";
+    dependency_string += "ComponentTask::Dependency::Direction::unknown, ";
    }}}
 
    //functionDebug += param.m_name;
    //functionDebug += " ";
 
+   std::string componentName {param.m_typeName}; 
    if (param.m_type == parse_params::Param::Type::This) {
     //functionDebug += "This ";
-    component_function_string += "ComponentTask::Dependency::Type::This, ";
+    dependency_string += "ComponentTask::Dependency::Type::This, ";
+    componentName = cpp2::as_<std::string>(CPP2_UFCS_0(name, t));
+    this_written = param.m_dir != parse_params::Param::Direction::in;
     //call_update_string += "this";
     firstParam = true;
    }
    else {if (param.m_type == parse_params::Param::Type::Ctx) {
     //functionDebug += "Ctx ";
     call_update_string += "ctx";
-    component_function_string += "ComponentTask::Dependency::Type::Ctx, ";
+    run_args_string += "ctx&$*";
+    dependency_string += "ComponentTask::Dependency::Type::Ctx, ";
    }
    else {if (param.m_type == parse_params::Param::Type::MyComponent) {
     //functionDebug += "MyComponent ";
-    component_function_string += "ComponentTask::Dependency::Type::MyComponent, ";
-    call_update_string += "cm.GetSystem<" + param.m_typeName + ">(\"" + param.m_typeName + "\")*.Get(ctx.thisEntityId)*";
+    dependency_string += "ComponentTask::Dependency::Type::MyComponent, ";
+    if (param.m_dir == parse_params::Param::Direction::in) {
+     //  readers see the previous frame of a double buffered component
+     call_update_string += "cm.GetSystem<" + param.m_typeName + ">(\"" + param.m_typeName + "\")*.GetRead(ctx.thisEntityId)*";
+     run_args_string += param.m_name + "System$*.GetReadAt(" + param.m_name + "Row)";
+    }
+    else {
+     call_update_string += "cm.GetSystem<" + param.m_typeName + ">(\"" + param.m_typeName + "\")*.GetWrite(ctx.thisEntityId, ctx.frameIndex)*";
+     run_args_string += param.m_name + "System$*.GetWriteAt(" + param.m_name + "Row, ctx&$*.frameIndex)";
+    }
+    run_join_params_string += ", " + param.m_name + "Row";
+    run_join_systems_string += ", " + param.m_name + "System";
+    run_lookup_string += "    " + param.m_name + "System := cm.GetSystem<" + param.m_typeName + ">(\"" + param.m_typeName + "\");\n";
    }
    else {if (param.m_type == parse_params::Param::Type::AllComponents) {
     //functionDebug += "AllComponents ";
-    component_function_string += "ComponentTask::Dependency::Type::AllComponents, ";
+    dependency_string += "ComponentTask::Dependency::Type::AllComponents, ";
     call_update_string += "cm.GetSystem<" + param.m_typeName + ">(\"" + param.m_typeName + "\")*";
+    run_lookup_string += "    " + param.m_name + "System := cm.GetSystem<" + param.m_typeName + ">(\"" + param.m_typeName + "\");\n";
+    run_args_string += param.m_name + "System$*";
+   }
+   else {if (param.m_type == parse_params::Param::Type::SpatialIndex) {
+    dependency_string += "ComponentTask::Dependency::Type::SpatialIndex, ";
+    call_update_string += "cm.GetSpatialIndex<" + param.m_typeName + ">()*";
+    run_lookup_string += "    " + param.m_name + "Index := cm.GetSpatialIndex<" + param.m_typeName + ">();\n";
+    run_args_string += param.m_name + "Index$*";
+   }
+   else {if (param.m_type == parse_params::Param::Type::EventStream) {
+    //  producers get their worker's buffer, consumers the published events
+    dependency_string += "ComponentTask::Dependency::Type::EventStream, ";
+    std::string stream_string {"cm.GetEventChannel<" + param.m_typeName + ">()*.Reader()"}; 
+    if (param.m_dir != parse_params::Param::Direction::in) {
+     stream_string = "cm.GetEventChannel<" + param.m_typeName + ">()*.Writer(ctx)";
+    }
+    call_lookup_string += "    " + param.m_name + "Events := " + stream_string + ";\n";
+    call_update_string += param.m_name + "Events&*";
+    run_lookup_string += "    " + param.m_name + "Events := " + stream_string + ";\n";
+    run_args_string += param.m_name + "Events&$*";
+   }
+   else {if (param.m_type == parse_params::Param::Type::Query) {
+    //  the query reads each of its components whole, like an `in` ComponentSystem<T>
+    dependency_string += "ComponentTask::Dependency::Type::AllComponents, ";
+    call_update_string += "cm.GetQuery<" + param.m_typeName + ">()*";
+    run_lookup_string += "    " + param.m_name + "Query := cm.GetQuery<" + param.m_typeName + ">();\n";
+    run_args_string += param.m_name + "Query$*";
    }
    else { // param.m_type == parse_params::Param::Type::Unknown
     //functionDebug += "Unknown ";
-    component_function_string += "ComponentTask::Dependency::Type::Unknown, ";
+    dependency_string += "ComponentTask::Dependency::Type::Unknown, ";
     call_update_string += "nullptr";
-   }}}}
-   component_function_string += "\"" + param.m_typeName + "\",";
-   component_function_string += "\"" + param.m_name + "\") );\n";
+    run_args_string += "nullptr";
+   }}}}}}}
+   //  A plain type name is taken for a component, so a shim must not compile when it is
+   //  not one, or it would find no system and silently match no rows
+   std::vector<std::string> component_types {}; 
+   if (param.m_type == parse_params::Param::Type::MyComponent || param.m_type == parse_params::Param::Type::AllComponents) {
+    CPP2_UFCS(push_back, component_types, param.m_typeName);
+   }
+   else {if (param.m_type == parse_params::Param::Type::Query) {
+    component_types = param.m_queryTypes;
+   }}
+   for ( auto const& component_type : component_types ) 
+   {
+    auto component_check {"    static_assert(IsComponentType<" + component_type + ">, \"" + id + " parameter '" + param.m_name + "': " + component_type + " is not a @component type\");\n"}; 
+    call_lookup_string += component_check;
+    run_lookup_string += component_check;
+   }
+
+   if (param.m_type == parse_params::Param::Type::Query) {
+    //  one dependency per component, none of them with fields
+    for ( auto const& queryType : param.m_queryTypes ) 
+    {
+     if (!(CPP2_UFCS_0(empty, dependencies_string))) {
+      dependencies_string += ",\n        ";
+     }
+     dependencies_string += dependency_string + "\"" + queryType + "\", \"" + param.m_name + "\", " + std::to_string(numFields) + ", 0)";
+     ++numDependencies;
+    }
+    continue;
+   }
+   dependency_string += "\"" + componentName + "\", ";
+   dependency_string += "\"" + param.m_name + "\", ";
+
+   //  Record the member fields the body touches so systems using disjoint fields can overlap
+   auto firstField {numFields}; 
+   if (param.m_type == parse_params::Param::Type::MyComponent) {
+    for ( auto const& access : (*cpp2::assert_not_null(field_parser)).m_params ) 
+    {
+     if (access.m_name == param.m_name && !(access.m_whole)) {
+      for ( auto const& field : access.m_fields ) 
+      {
+       if (!(CPP2_UFCS_0(empty, fields_string))) {
+        fields_string += ",\n        ";
+       }
+       fields_string += "ComponentTask::Dependency::Field(";
+       if (field.m_written) {
+        fields_string += "ComponentTask::Dependency::Direction::inout, ";
+       }
+       else {
+        fields_string += "ComponentTask::Dependency::Direction::in, ";
+       }
+       fields_string += "\"" + field.m_name + "\")";
+       ++numFields;
+      }
+     }
+    }
+   }
+   dependency_string += std::to_string(firstField) + ", " + std::to_string(numFields - firstField) + ")";
+
+   if (!(CPP2_UFCS_0(empty, dependencies_string))) {
+    dependencies_string += ",\n        ";
+   }
+   dependencies_string += dependency_string;
+   ++numDependencies;
 
    //functionDebug += param.m_typeName;
    //functionDebug += ",";
 
   }
   //functionDebug += ")\n";
-  component_function_string += "    result.push_back(" + idFn + ");\n";
+  if (!(CPP2_UFCS_0(empty, tasks_string))) {
+   tasks_string += ",\n        ";
+  }
+  tasks_string += "ComponentTask(\"" + id + "\", " + std::to_string(firstDependency) + ", " + std::to_string(numDependencies - firstDependency) + ")";
 
   call_update_string += ");\n";
-  call_update_string += "}\n";
-  CPP2_UFCS(require, t, CPP2_UFCS(add_member, t, call_update_string), "could not add call_update_string");
- }
+  CPP2_UFCS(push_back, generated_members, "Call" + id + ": (inout this, inout ctx : ECS_Context, inout cm : ComponentManager) = { \n" 
+   + call_lookup_string + call_update_string + "}\n");
 
-    component_function_string += "    return result;\n";
-    component_function_string += "}\n";
-
- //std::cout << "functionDebug:\n" << functionDebug << "\n";
-    CPP2_UFCS(require, t, CPP2_UFCS(add_member, t, std::move(component_function_string)), "could not add component_function_string");
-
-#line 824 "./thirdparty/cppfront/source/reflect.h2"
-    std::string memberNameString {""}; 
-    auto first {true}; 
- for ( auto& m : CPP2_UFCS_0(get_members, t) ) 
-    {
-        if (CPP2_UFCS_0(is_function, m)) {
+  if (std::find(CPP2_UFCS_0(begin, declared_runs), CPP2_UFCS_0(end, declared_runs), "Run" + id) != CPP2_UFCS_0(end, declared_runs)) {
    continue;
   }
-        if (CPP2_UFCS_0(is_object, m)) {
-            auto mf {CPP2_UFCS_0(as_object, m)}; 
-        }
 
-        if (CPP2_UFCS_0(has_name, m)) {
-            auto memberName {"\"" + (cpp2::as_<std::string>(CPP2_UFCS_0(name, m))) + "\""}; 
-            if ((first)) {
-               memberNameString += memberName;
-               first = false;
-            }else {
-               memberNameString += ", " + memberName;
-            }
+  std::string run_update_string {""}; 
+  run_update_string += "Run" + id + ": (rows : ComponentRange<" + (cpp2::as_<std::string>(CPP2_UFCS_0(name, t))) + ">, inout ctx : ECS_Context, inout cm : ComponentManager) = { \n";
+  run_update_string += run_lookup_string;
+  if (this_written) {
+   run_update_string += "    rows.MarkChanged(ctx.frameIndex);\n";
+  }
+  run_update_string += "    JoinRows(rows, :(row" + run_join_params_string + ") = {\n";
+  run_update_string += "        ctx&$*.thisEntityId = row.mEntity;\n";
+  run_update_string += "        row.mComponent." + id + "(" + run_args_string + ");\n";
+  run_update_string += "    }" + run_join_systems_string + ");\n";
+  run_update_string += "}\n";
+  CPP2_UFCS(push_back, generated_members, run_update_string);
+ }
 
-   CPP2_UFCS_0(default_to_public, m);
-   //m.require( m.make_public(), "all data members must be public");
-        }
-    }
+ //std::cout << "functionDebug:\n" << functionDebug << "\n";
+    CPP2_UFCS(push_back, generated_members, "ComponentTasks: == MakeComponentTable<ComponentTask>(" + std::move(tasks_string) + ");\n");
+    CPP2_UFCS(push_back, generated_members, "ComponentDependencies: == MakeComponentTable<ComponentTask::Dependency>(" + std::move(dependencies_string) + ");\n");
+    CPP2_UFCS(push_back, generated_members, "ComponentFields: == MakeComponentTable<ComponentTask::Dependency::Field>(" + std::move(fields_string) + ");\n");
 
-    std::string member_string {""}; 
-    member_string += "members: () -> std::vector<std::string> = { \n";
-    member_string += "    a : std::vector<std::string> = (";
-    member_string += std::move(memberNameString);
-    member_string += ");\n";
-    member_string += "    return a;\n";
-    member_string += "}\n";
+#line 1055 "./thirdparty/cppfront/source/reflect.h2"
+    CPP2_UFCS(push_back, generated_members, "ComponentMembers: == MakeComponentTable<std::string_view>(" + std::move(memberNameString) + ");\n");
 
-    CPP2_UFCS(require, t, CPP2_UFCS(add_member, t, std::move(member_string)), "could not add member_string");
+    //  Lex and parse everything generated above in one pass
+    CPP2_UFCS(require, t, CPP2_UFCS(add_members, t, std::move(generated_members)), 
+               "could not add the generated component members");
 
  CPP2_UFCS_0(disable_member_function_generation, t);
 
 }
 
-#line 880 "./thirdparty/cppfront/source/reflect.h2"
+#line 1070 "./thirdparty/cppfront/source/reflect.h2"
+auto double_buffered(meta::type_declaration& t) -> void
+{
+    CPP2_UFCS(require, t, CPP2_UFCS(add_member, t, "IsDoubleBuffered: () -> bool = { return true; }"), 
+               "could not add IsDoubleBuffered");
+}
+
+#line 1082 "./thirdparty/cppfront/source/reflect.h2"
+auto on_change(meta::type_declaration& t) -> void
+{
+    CPP2_UFCS(require, t, CPP2_UFCS(add_member, t, "IsChangeDriven: () -> bool = { return true; }"), 
+               "could not add IsChangeDriven");
+}
+
+#line 1105 "./thirdparty/cppfront/source/reflect.h2"
 auto copyable(meta::type_declaration& t) -> void
 {
     //  If the user explicitly wrote any of the copy/move functions,
@@ -1554,7 +1827,7 @@ auto copyable(meta::type_declaration& t) -> void
     }}
 }
 
-#line 909 "./thirdparty/cppfront/source/reflect.h2"
+#line 1134 "./thirdparty/cppfront/source/reflect.h2"
 auto basic_value(meta::type_declaration& t) -> void
 {
     CPP2_UFCS_0(copyable, t);
@@ -1574,7 +1847,7 @@ auto basic_value(meta::type_declaration& t) -> void
     }
 }
 
-#line 938 "./thirdparty/cppfront/source/reflect.h2"
+#line 1163 "./thirdparty/cppfront/source/reflect.h2"
 auto value(meta::type_declaration& t) -> void
 {
     CPP2_UFCS_0(ordered, t);
@@ -1599,7 +1872,7 @@ auto cpp2_component_value(meta::type_declaration& t) -> void
     CPP2_UFCS_0(basic_value, t);
 }
 
-#line 988 "./thirdparty/cppfront/source/reflect.h2"
+#line 1213 "./thirdparty/cppfront/source/reflect.h2"
 auto cpp2_struct(meta::type_declaration& t) -> void
 {
     for ( auto& m : CPP2_UFCS_0(get_members, t) ) 
@@ -1617,18 +1890,18 @@ auto cpp2_struct(meta::type_declaration& t) -> void
     CPP2_UFCS_0(disable_member_function_generation, t);
 }
 
-#line 1029 "./thirdparty/cppfront/source/reflect.h2"
+#line 1254 "./thirdparty/cppfront/source/reflect.h2"
 [[nodiscard]] auto basic_enum(
     meta::type_declaration& t, 
     auto const& nextval, 
     cpp2::in<bool> bitwise
     ) -> basic_enum__ret
 
-#line 1038 "./thirdparty/cppfront/source/reflect.h2"
+#line 1263 "./thirdparty/cppfront/source/reflect.h2"
 {
     std::string underlying_type {""};
         cpp2::deferred_init<std::string> strict_underlying_type;
-#line 1039 "./thirdparty/cppfront/source/reflect.h2"
+#line 1264 "./thirdparty/cppfront/source/reflect.h2"
     std::vector<value_member_info> enumerators {}; 
     cpp2::i64 min_value {0}; 
     cpp2::i64 max_value {0}; 
@@ -1638,7 +1911,7 @@ cpp2::i64 value = -1;
 
     //  1. Gather: The names of all the user-written members, and find/compute the type
 
-#line 1046 "./thirdparty/cppfront/source/reflect.h2"
+#line 1271 "./thirdparty/cppfront/source/reflect.h2"
     for ( 
 
           auto const& m : CPP2_UFCS_0(get_members, t) )  { do 
@@ -1670,7 +1943,7 @@ cpp2::i64 value = -1;
 }
 
     //  Compute the default underlying type, if it wasn't explicitly specified
-#line 1076 "./thirdparty/cppfront/source/reflect.h2"
+#line 1301 "./thirdparty/cppfront/source/reflect.h2"
     if (underlying_type == "") {
         if (!(bitwise)) {
 
@@ -1709,7 +1982,7 @@ cpp2::i64 value = -1;
 
     strict_underlying_type.construct("cpp2::strict_value<" + cpp2::to_string(underlying_type) + "," + cpp2::to_string(CPP2_UFCS_0(name, t)) + "," + cpp2::to_string(bitwise) + ">");
 
-#line 1115 "./thirdparty/cppfront/source/reflect.h2"
+#line 1340 "./thirdparty/cppfront/source/reflect.h2"
     //  2. Replace: Erase the contents and replace with modified contents
 
     CPP2_UFCS_0(remove_all_members, t);
@@ -1778,13 +2051,13 @@ cpp2::i64 value = -1;
     CPP2_UFCS(require, t, CPP2_UFCS(add_member, t, "    to_string: (this) -> std::string = { return " + cpp2::to_string(CPP2_UFCS_0(name, t)) + "::to_string(this); }"), 
                "could not add to_string member function");
 
-#line 1184 "./thirdparty/cppfront/source/reflect.h2"
+#line 1409 "./thirdparty/cppfront/source/reflect.h2"
     //  3. A basic_enum is-a value type
 
     CPP2_UFCS_0(basic_value, t);
 return  { std::move(underlying_type), std::move(strict_underlying_type.value()) }; }
 
-#line 1199 "./thirdparty/cppfront/source/reflect.h2"
+#line 1424 "./thirdparty/cppfront/source/reflect.h2"
 auto cpp2_enum(meta::type_declaration& t) -> void
 {
     //  Let basic_enum do its thing, with an incrementing value generator
@@ -1800,7 +2073,7 @@ auto cpp2_enum(meta::type_declaration& t) -> void
     ));
 }
 
-#line 1225 "./thirdparty/cppfront/source/reflect.h2"
+#line 1450 "./thirdparty/cppfront/source/reflect.h2"
 auto flag_enum(meta::type_declaration& t) -> void
 {
     //  Add "none" member as a regular name to signify "no flags set"
@@ -1825,7 +2098,7 @@ auto flag_enum(meta::type_declaration& t) -> void
     ));
 }
 
-#line 1274 "./thirdparty/cppfront/source/reflect.h2"
+#line 1499 "./thirdparty/cppfront/source/reflect.h2"
 auto cpp2_union(meta::type_declaration& t) -> void
 {
     std::vector<value_member_info> alternatives {}; 
@@ -1849,7 +2122,7 @@ auto cpp2_union(meta::type_declaration& t) -> void
         }
     }
 
-#line 1298 "./thirdparty/cppfront/source/reflect.h2"
+#line 1523 "./thirdparty/cppfront/source/reflect.h2"
     //  2. Replace: Erase the contents and replace with modified contents
 
     CPP2_UFCS_0(remove_all_members, t);
@@ -1859,7 +2132,7 @@ auto cpp2_union(meta::type_declaration& t) -> void
 {
 std::string comma = "";
 
-#line 1306 "./thirdparty/cppfront/source/reflect.h2"
+#line 1531 "./thirdparty/cppfront/source/reflect.h2"
     for ( 
 
           auto const& e : alternatives )  { do {
@@ -1867,21 +2140,21 @@ std::string comma = "";
     } while (false); comma = ", "; }
 }
 
-#line 1312 "./thirdparty/cppfront/source/reflect.h2"
+#line 1537 "./thirdparty/cppfront/source/reflect.h2"
     Size += " );\n";
     CPP2_UFCS(require, t, CPP2_UFCS(add_member, t, std::move(Size)), 
                "could not add Size");
 
-#line 1318 "./thirdparty/cppfront/source/reflect.h2"
+#line 1543 "./thirdparty/cppfront/source/reflect.h2"
     //  TODO
 
-#line 1322 "./thirdparty/cppfront/source/reflect.h2"
+#line 1547 "./thirdparty/cppfront/source/reflect.h2"
     ////  3. A basic_enum is-a value
 
     //t.value();
 }
 
-#line 1331 "./thirdparty/cppfront/source/reflect.h2"
+#line 1556 "./thirdparty/cppfront/source/reflect.h2"
 }
 }
 
@@ -179,7 +179,7 @@ struct symbol {
 //  of the form "x = expr;" for an uninitialized local variable x,
 //  which we will rewrite to construct the local variable.
 //
-std::vector<token const*> definite_initializations;
+thread_local std::vector<token const*> definite_initializations;
 
 auto is_definite_initialization(token const* t)
     -> bool
@@ -212,7 +212,7 @@ struct last_use {
 
     bool operator==(last_use const& that) { return t == that.t; }
 };
-std::vector<last_use> definite_last_uses;
+thread_local std::vector<last_use> definite_last_uses;
 
 auto is_definite_last_use(token const* t)
     -> last_use const*